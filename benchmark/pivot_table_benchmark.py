@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""Benchmark pivot_table and pivot_table_native over synthetic fact tables.
+
+Each case changes one dimension of a base pivot (the number of rows, the number and cardinality of the columns,
+the number of values, values_axis, subtotals/grand_totals, the filter selectivity and the number of tables), and is run
+in a fresh DuckDB CLI process so that its peak memory can be measured on its own.
+One JSON object is written per case (JSON lines), for example:
+
+    {"scale": 1000000, "function": "pivot_table", "dimension": "rows", "case": "3", "wall_seconds": 0.41, ...}
+
+Usage (after `make release`, or use `make bench`):
+
+    python3 benchmark/pivot_table_benchmark.py --scales 1000000,10000000 --output bench.jsonl
+    python3 benchmark/pivot_table_benchmark.py --baseline bench.jsonl --threshold 1.25
+"""
+
+import argparse
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+import time
+
+BENCHMARK_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_DUCKDB = os.path.join(BENCHMARK_DIR, '..', 'build', 'release', 'duckdb')
+DEFAULT_DATA_DIR = os.path.join(BENCHMARK_DIR, 'data')
+
+# The columns of the fact table. The row_N and col_N columns have N distinct values, value_N are the measures
+# and selectivity is uniform over 0-99 (so selectivity < 10 keeps about 10% of the rows).
+FACT_TABLE_SQL = """
+CREATE OR REPLACE TABLE fact AS
+SELECT
+    i AS id,
+    (hash(i, 1) % 10)::INTEGER AS row_10,
+    (hash(i, 2) % 100)::INTEGER AS row_100,
+    (hash(i, 3) % 1000)::INTEGER AS row_1000,
+    (hash(i, 4) % 10000)::INTEGER AS row_10000,
+    'c' || (hash(i, 5) % 4) AS col_4,
+    'c' || (hash(i, 6) % 8) AS col_8,
+    'c' || (hash(i, 7) % 16) AS col_16,
+    'c' || (hash(i, 8) % 64) AS col_64,
+    'c' || (hash(i, 9) % 1024) AS col_1024,
+    (hash(i, 10) % 100000)::DOUBLE / 100 AS value_1,
+    (hash(i, 11) % 1000)::INTEGER AS value_2,
+    (hash(i, 12) % 100000)::DOUBLE / 100 AS value_3,
+    (hash(i, 13) % 1000)::INTEGER AS value_4,
+    (hash(i, 14) % 100)::INTEGER AS selectivity
+FROM range({scale}) t(i);
+"""
+
+BASE_CASE = {
+    'values': ['sum(value_1)'],
+    'rows': ['row_10', 'row_100'],
+    'columns': ['col_64'],
+    'filters': [],
+    'values_axis': 'columns',
+    'subtotals': False,
+    'grand_totals': False,
+    'tables': 1,
+}
+
+# Each dimension is swept on its own, keeping the rest of the base case
+DIMENSIONS = {
+    'rows': {
+        '0': {'rows': []},
+        '1': {'rows': ['row_10']},
+        '2': {'rows': ['row_10', 'row_100']},
+        '3': {'rows': ['row_10', 'row_100', 'row_1000']},
+        '4': {'rows': ['row_10', 'row_100', 'row_1000', 'row_10000']},
+    },
+    'columns': {
+        '0': {'columns': []},
+        '1': {'columns': ['col_4']},
+        '2': {'columns': ['col_4', 'col_8']},
+        '3': {'columns': ['col_4', 'col_8', 'col_16']},
+    },
+    'column_cardinality': {
+        '4': {'columns': ['col_4']},
+        '64': {'columns': ['col_64']},
+        '1024': {'columns': ['col_1024']},
+    },
+    'values': {
+        '1': {'values': ['sum(value_1)']},
+        '2': {'values': ['sum(value_1)', 'count(*)']},
+        '4': {'values': ['sum(value_1)', 'count(*)', 'max(value_3)', 'min(value_4)']},
+    },
+    'values_axis': {
+        'columns': {'values': ['sum(value_1)', 'sum(value_3)'], 'values_axis': 'columns'},
+        'rows': {'values': ['sum(value_1)', 'sum(value_3)'], 'values_axis': 'rows'},
+    },
+    'totals': {
+        'none': {},
+        'subtotals': {'subtotals': True},
+        'grand_totals': {'grand_totals': True},
+        'both': {'subtotals': True, 'grand_totals': True},
+    },
+    'filter_selectivity': {
+        '100%': {'filters': []},
+        '50%': {'filters': ['selectivity < 50']},
+        '10%': {'filters': ['selectivity < 10']},
+        '1%': {'filters': ['selectivity < 1']},
+    },
+    'tables': {
+        '1': {'tables': 1},
+        '4': {'tables': 4},
+        '16': {'tables': 16},
+    },
+}
+
+FUNCTIONS = ['pivot_table', 'pivot_table_native']
+
+
+def sql_list(items):
+    return '[' + ', '.join("'" + item.replace("'", "''") + "'" for item in items) + ']'
+
+
+def table_names(tables):
+    return ['fact'] if tables == 1 else ['fact_%d_of_%d' % (k, tables) for k in range(tables)]
+
+
+def pivot_arguments(case):
+    return '%s, %s, %s, %s, %s, values_axis:=%s, subtotals:=%d, grand_totals:=%d' % (
+        sql_list(table_names(case['tables'])), sql_list(case['values']), sql_list(case['rows']),
+        sql_list(case['columns']), sql_list(case['filters']), "'" + case['values_axis'] + "'", case['subtotals'],
+        case['grand_totals'])
+
+
+def measured_statements(function, case):
+    """The statements whose run time is measured: what a user runs to get the pivot (including the enum)."""
+    statements = []
+    if function == 'pivot_table':
+        statements.append('DROP TYPE IF EXISTS columns_parameter_enum;')
+        statements.append('CREATE TYPE columns_parameter_enum AS ENUM (FROM build_my_enum(%s, %s, %s));' % (
+            sql_list(table_names(case['tables'])), sql_list(case['columns']), sql_list(case['filters'])))
+    statements.append('CREATE OR REPLACE TEMP TABLE pivot_output AS FROM %s(%s);' % (function, pivot_arguments(case)))
+    return statements
+
+
+def run_cli(duckdb, database, script):
+    """Run a script in a new DuckDB CLI process. Returns its output and its peak memory in bytes."""
+    process = subprocess.Popen([duckdb, '-bail', database], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                               stderr=subprocess.STDOUT, universal_newlines=True)
+    # The output is small (the pivot is stored in a table), so write the whole script before reading it.
+    # The process is waited on with wait4, which also returns its own resource usage.
+    process.stdin.write(script)
+    process.stdin.close()
+    output = process.stdout.read()
+    process.stdout.close()
+    _, status, usage = os.wait4(process.pid, 0)
+    if status != 0 or 'Error' in output:
+        raise RuntimeError('duckdb failed:\n%s\n%s' % (script, output.strip()))
+    # ru_maxrss is in kilobytes on Linux and in bytes on macOS
+    peak_memory = usage.ru_maxrss if sys.platform == 'darwin' else usage.ru_maxrss * 1024
+    return output, peak_memory
+
+
+def prepare_data(duckdb, data_dir, scale, tables):
+    """Create the fact table (and its partitions) once per scale, in a database file that is reused."""
+    os.makedirs(data_dir, exist_ok=True)
+    database = os.path.join(data_dir, 'pivot_table_%d.duckdb' % scale)
+    existing, _ = run_cli(duckdb, database,
+                          '.mode list\n.headers off\nSELECT table_name FROM duckdb_tables() ORDER BY ALL;\n')
+    existing = set(existing.split())
+    script = ''
+    if 'fact' not in existing:
+        script += FACT_TABLE_SQL.format(scale=scale)
+    for count in sorted(tables):
+        for name in table_names(count):
+            if count > 1 and name not in existing:
+                k = int(name.split('_')[1])
+                script += 'CREATE TABLE %s AS FROM fact WHERE id %% %d = %d;\n' % (name, count, k)
+    if script:
+        started = time.time()
+        sys.stderr.write('generating %d rows in %s\n' % (scale, database))
+        run_cli(duckdb, database, script)
+        sys.stderr.write('generated in %.1fs\n' % (time.time() - started))
+    return database
+
+
+def run_case(duckdb, database, function, case):
+    script = '.mode list\n.headers off\n.timer on\n'
+    script += '\n'.join(measured_statements(function, case)) + '\n'
+    script += ".timer off\nSELECT 'output_rows=' || count(*) FROM pivot_output;\n"
+    output, peak_memory = run_cli(duckdb, database, script)
+    wall_seconds = sum(float(t) for t in re.findall(r'Run Time \(s\): real ([0-9.]+)', output))
+    output_rows = int(re.search(r'output_rows=([0-9]+)', output).group(1))
+    return wall_seconds, peak_memory, output_rows
+
+
+def cases(dimensions):
+    for dimension in dimensions:
+        for name, changes in DIMENSIONS[dimension].items():
+            case = dict(BASE_CASE)
+            case.update(changes)
+            yield dimension, name, case
+
+
+def case_key(record):
+    return (record['scale'], record['function'], record['dimension'], record['case'])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--duckdb', default=DEFAULT_DUCKDB, help='the DuckDB CLI, with the extension linked in')
+    parser.add_argument('--data-dir', default=DEFAULT_DATA_DIR, help='where the generated databases are kept')
+    parser.add_argument('--scales', default='1000000', help='comma separated row counts (Ex: 1000000,10000000)')
+    parser.add_argument('--dimensions', default=','.join(DIMENSIONS), help='comma separated dimensions to sweep')
+    parser.add_argument('--functions', default=','.join(FUNCTIONS), help='comma separated functions to run')
+    parser.add_argument('--repeat', type=int, default=3, help='runs per case (the median wall time is reported)')
+    parser.add_argument('--output', help='also write the results to this file (JSON lines)')
+    parser.add_argument('--baseline', help='a previous output file to compare the wall times against')
+    parser.add_argument('--threshold', type=float, default=1.25,
+                        help='fail if a case is this many times slower than in the baseline')
+    options = parser.parse_args()
+
+    scales = [int(scale) for scale in options.scales.split(',')]
+    dimensions = options.dimensions.split(',')
+    functions = options.functions.split(',')
+    unknown = set(dimensions) - set(DIMENSIONS)
+    if unknown:
+        parser.error('unknown dimensions: %s' % ', '.join(sorted(unknown)))
+    tables = {case['tables'] for _, _, case in cases(dimensions)}
+
+    baseline = {}
+    if options.baseline:
+        with open(options.baseline) as f:
+            for line in f:
+                record = json.loads(line)
+                baseline[case_key(record)] = record
+
+    output = open(options.output, 'w') if options.output else None
+    regressions = []
+    for scale in scales:
+        database = prepare_data(options.duckdb, options.data_dir, scale, tables)
+        for dimension, name, case in cases(dimensions):
+            for function in functions:
+                runs = [run_case(options.duckdb, database, function, case) for _ in range(options.repeat)]
+                wall_seconds = statistics.median(run[0] for run in runs)
+                record = {
+                    'scale': scale,
+                    'function': function,
+                    'dimension': dimension,
+                    'case': name,
+                    'arguments': pivot_arguments(case),
+                    'wall_seconds': round(wall_seconds, 6),
+                    'peak_memory_bytes': max(run[1] for run in runs),
+                    'rows_per_second': round(scale / wall_seconds) if wall_seconds > 0 else None,
+                    'output_rows': runs[0][2],
+                    'repeat': options.repeat,
+                }
+                previous = baseline.get(case_key(record))
+                if previous:
+                    record['baseline_wall_seconds'] = previous['wall_seconds']
+                    if wall_seconds > previous['wall_seconds'] * options.threshold:
+                        regressions.append(record)
+                line = json.dumps(record)
+                print(line, flush=True)
+                if output:
+                    output.write(line + '\n')
+    if output:
+        output.close()
+
+    for record in regressions:
+        sys.stderr.write('REGRESSION %s %s %s=%s: %.3fs (baseline %.3fs)\n' % (
+            record['scale'], record['function'], record['dimension'], record['case'], record['wall_seconds'],
+            record['baseline_wall_seconds']))
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "duckdb.hpp"
+
+namespace duckdb {
+
+//! pivot_table_batch(table_names, specs) computes many pivots of the same tables, reading the tables only once.
+//! Each spec is a struct with a name, the values, rows, columns and filters lists, and any of the named options of
+//! pivot_table_native (Ex: subtotals). The pivot of each spec is written to the table with its name, laid out like
+//! pivot_table_native, and one row is returned per spec (its name and the number of rows and columns written).
+struct PivotTableBatchFunction {
+	static TableFunction GetFunction();
+};
+
+} // namespace duckdb
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/list.hpp"
+#include "duckdb/common/mutex.hpp"
+#include "duckdb/function/table_function.hpp"
+#include "duckdb/main/client_context_state.hpp"
+#include "duckdb/storage/object_cache.hpp"
+#include "pivot_table_sql.hpp"
+
+namespace duckdb {
+
+struct PivotTableCacheStats {
+	idx_t hits = 0;
+	idx_t misses = 0;
+	idx_t evictions = 0;
+};
+
+//! A least-recently-used map from a pivot's shape (its arguments as SQL literals) to a cached value.
+//! Not thread-safe: the owner holds a lock.
+template <class T>
+class PivotTableLRUCache {
+public:
+	explicit PivotTableLRUCache(idx_t capacity) : capacity(capacity) {
+	}
+
+	//! Return the cached value (and mark it as recently used), or nullptr on a miss
+	T *Get(const string &key) {
+		auto entry = index.find(key);
+		if (entry == index.end()) {
+			stats.misses++;
+			return nullptr;
+		}
+		stats.hits++;
+		entries.splice(entries.begin(), entries, entry->second);
+		return &entry->second->second;
+	}
+
+	void Put(const string &key, T value) {
+		auto entry = index.find(key);
+		if (entry != index.end()) {
+			entries.erase(entry->second);
+			index.erase(entry);
+		}
+		entries.emplace_front(key, std::move(value));
+		index[key] = entries.begin();
+		while (entries.size() > capacity) {
+			index.erase(entries.back().first);
+			entries.pop_back();
+			stats.evictions++;
+		}
+	}
+
+	void Erase(const string &key) {
+		auto entry = index.find(key);
+		if (entry == index.end()) {
+			return;
+		}
+		entries.erase(entry->second);
+		index.erase(entry);
+		stats.evictions++;
+	}
+
+	idx_t Size() const {
+		return entries.size();
+	}
+	idx_t Capacity() const {
+		return capacity;
+	}
+
+	PivotTableCacheStats stats;
+
+private:
+	idx_t capacity;
+	list<std::pair<string, T>> entries;
+	unordered_map<string, typename list<std::pair<string, T>>::iterator> index;
+};
+
+//! The SQL generated for pivot_table_native (see PivotTableSQLBuilder::NativeInput), shared by every connection
+//! to a database. The generated SQL only depends on the arguments, so entries never go stale.
+class PivotTableSQLCache : public ObjectCacheEntry {
+public:
+	static constexpr idx_t CAPACITY = 1024;
+
+	PivotTableSQLCache() : sql(CAPACITY) {
+	}
+
+	static shared_ptr<PivotTableSQLCache> Get(ClientContext &context);
+	static string ObjectType() {
+		return "pivot_table_sql_cache";
+	}
+	string GetObjectType() override {
+		return ObjectType();
+	}
+
+	//! Return the SQL for the arguments, building and validating it on a miss
+	string GetSQL(ClientContext &context, const PivotTableArguments &args);
+
+	mutex lock;
+	PivotTableLRUCache<string> sql;
+};
+
+//! The prepared plans of one client connection. Pivots are planned and run on a separate connection
+//! (the client's own connection is busy binding the query that calls pivot_table_native), which is kept here.
+//! DuckDB rebinds a prepared statement by itself if the catalog has changed since it was prepared.
+class PivotTablePlanCache : public ClientContextState {
+public:
+	static constexpr idx_t CAPACITY = 128;
+
+	PivotTablePlanCache() : plans(CAPACITY) {
+	}
+
+	static shared_ptr<PivotTablePlanCache> Get(ClientContext &context);
+
+	//! Run the SQL generated for the arguments, binding the parameters ($1, $2, ...).
+	//! Errors from preparing the statement are returned in the result instead of thrown, so the caller can retry
+	//! without parameters (see PivotTableIsBindError). Errors from running it are thrown.
+	unique_ptr<MaterializedQueryResult> Execute(ClientContext &context, const PivotTableArguments &args,
+	                                            vector<Value> &parameters);
+	//! The separate connection, created on first use, with the search path, the extension settings (Ex: TimeZone),
+	//! the variables and integer_division of the client copied onto it. The caller holds the lock.
+	Connection &GetConnection(ClientContext &context);
+	//! The separate connection reads the committed tables of the database while binding, so refuse what it can not
+	//! see: the uncommitted changes of a transaction that the client has opened, and its temporary tables and views.
+	//! A prepared statement is bound again every time it runs, instead of reading the data it was prepared with.
+	static void CheckSnapshot(ClientContext &context, TableFunctionBindInput &input, const string &function_name,
+	                          const vector<string> &table_names);
+
+	mutex lock;
+	unique_ptr<Connection> connection;
+	//! The search path that was last set on the connection (empty for the default one), and the session state that it
+	//! was last given as text
+	string connection_search_path;
+	string session_key;
+	PivotTableLRUCache<shared_ptr<PreparedStatement>> plans;
+};
+
+//! Replace every literal in the filters with a parameter ($1, $2, ...), so that pivots which only differ in their
+//! filter literals share one cached plan. The literals are appended to parameters.
+vector<string> PivotTableParameterizeFilters(const vector<string> &filters, vector<Value> &parameters);
+
+//! Whether an error is from binding the statement (Ex: a literal that can not be a parameter), so that it can be
+//! prepared again differently. Any other error would happen again.
+bool PivotTableIsBindError(const ErrorData &error);
+
+//! pivot_table_cache_stats() reports the entries, hits, misses and evictions of each cache
+struct PivotTableCacheStatsFunction {
+	static TableFunction GetFunction();
+};
+
+} // namespace duckdb
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "duckdb.hpp"
+
+namespace duckdb {
+
+//! pivot_table_materialize(name, table_names, values, rows, columns, filters) stores the partial aggregates of a
+//! pivot in the table name, and pivot_table_refresh(name) folds in only the rows that were appended since then.
+//! Both return the pivot, laid out like pivot_table_native (no enum is needed).
+//! The arguments and the watermark of each table are kept in the pivot_table_materializations table, and only a table
+//! that is recorded there is replaced. Both are written and committed when the query runs (not when it is only bound).
+struct PivotTableMaterializeFunction {
+	static TableFunction GetFunction();
+	static TableFunction GetRefreshFunction();
+};
+
+} // namespace duckdb
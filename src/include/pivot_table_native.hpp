@@ -0,0 +1,54 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/function/table_function.hpp"
+#include "pivot_table_sql.hpp"
+
+#include <functional>
+
+namespace duckdb {
+
+//! pivot_table_native has the same parameters as pivot_table, but does not need the columns_parameter_enum.
+//! The pivot keys are discovered in the same pass over the raw data as the aggregation,
+//! and are laid out as output columns once the aggregation has finished.
+struct PivotTableNativeFunction {
+	static TableFunction GetFunction();
+
+	//! A table function that lays out the aggregated data in long format (see PivotTableSQLBuilder::NativeInput)
+	//! that its bind function produces with BindInput, the same way as pivot_table_native does
+	static TableFunction CreateFunction(const string &name, vector<LogicalType> arguments,
+	                                    table_function_bind_t bind);
+	//! Discover the pivot keys in the input, and return the bind data and the output columns. on_execute (if any) runs
+	//! once the query runs, before the first row is returned, and not when it is only bound (Ex: EXPLAIN or PREPARE).
+	static unique_ptr<FunctionData> BindInput(const PivotTableArguments &args, unique_ptr<MaterializedQueryResult> input,
+	                                          vector<LogicalType> &return_types, vector<string> &names,
+	                                          std::function<void(ClientContext &)> on_execute = nullptr);
+	//! The temporary table that the partials of each partition are appended to (see WritePartitions)
+	static constexpr const char *PARTITIONS_TABLE = "pivot_table_partitions";
+	//! The temporary table that the rows are copied to, with their partition, before the partitions are aggregated
+	static constexpr const char *PARTITION_SCAN_TABLE = "pivot_table_partition_scan";
+	//! With partitions, read the tables once into PARTITION_SCAN_TABLE, and aggregate the partials of one partition at a
+	//! time from there into PARTITIONS_TABLE on the connection (the caller holds the lock of the plan cache).
+	//! on_statement (if any) runs after each statement (Ex: to read its profile). Returns the statement that pivots
+	//! every partition, like NativeInput. The caller drops the table with DropPartitions once the statement has run.
+	static string WritePartitions(Connection &con, const string &function_name, const PivotTableArguments &args,
+	                              const std::function<void()> &on_statement = nullptr);
+	static void DropPartitions(Connection &con);
+
+	//! Lay out the bind data that BindInput returned (with the types it returned) into the appender, instead of
+	//! returning it from a scan. Returns the number of rows appended.
+	static idx_t AppendOutput(const FunctionData &bind_data, const vector<LogicalType> &types, Appender &appender);
+};
+
+//! Add the columns that a pivot refers to: the rows, the columns, and the unqualified column references in the
+//! values, the filters and rank_by. Returns false if those are not all of them (Ex: COLUMNS(*), or an expression
+//! that does not parse).
+bool PivotTableReferencedColumns(const PivotTableArguments &args, vector<string> &names);
+
+//! The columns of the tables that are referenced, in the order of the tables. Names that are not columns (Ex: lambda
+//! parameters, or sample_rows) are left out, and if none of them is (Ex: only count(*)), the first column keeps the
+//! rows.
+vector<string> PivotTableScannedColumns(Connection &con, const vector<string> &table_names,
+                                        const vector<string> &referenced);
+
+} // namespace duckdb
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "duckdb.hpp"
+
+namespace duckdb {
+
+//! pivot_table_profile has the same parameters as pivot_table (plus native := true to profile pivot_table_native).
+//! It runs the pivot and returns one row per metric: the time spent generating, parsing, planning and running the
+//! SQL, and what the query did in terms of the pivot (the rollup levels, the value expressions, the pivot keys, the
+//! scans of the source tables and the rows they read, the aggregation and the sort).
+//! With native := true and partitions, the partitions are aggregated first, and the peak memory includes them.
+struct PivotTableProfileFunction {
+	static TableFunction GetFunction();
+};
+
+} // namespace duckdb
@@ -0,0 +1,223 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/named_parameter_map.hpp"
+#include "duckdb/common/optional_idx.hpp"
+
+namespace duckdb {
+
+//! The parameters of pivot_table (and pivot_table_native)
+struct PivotTableArguments {
+	vector<string> table_names;
+	vector<string> values;
+	vector<string> rows;
+	vector<string> columns;
+	vector<string> filters;
+	string values_axis = "columns";
+	bool subtotals = false;
+	bool grand_totals = false;
+	//! Whether the output is sorted. Without sorting, rows can be returned as soon as they are ready.
+	bool ordered = true;
+	//! The maximum number of output rows (the first rows if ordered), if any
+	optional_idx max_rows;
+	//! The maximum number of pivot keys (distinct combinations of the columns), if any
+	optional_idx max_pivot_keys;
+	//! What to do with more pivot keys than max_pivot_keys: 'error', 'other' (keep the top keys by rank_by and
+	//! collapse the rest into an Other key) or 'long' (return one row per pivot key instead of one column)
+	string overflow = "error";
+	//! The aggregate that ranks the pivot keys when overflow is 'other' (the first value by default)
+	string rank_by;
+	//! Whether to use the approximate aggregate instead of an exact one where there is one (Ex: approx_count_distinct
+	//! instead of count(DISTINCT x), reservoir_quantile instead of median or quantile)
+	bool approx = false;
+	//! The fraction of the rows to aggregate (a sample of whole vectors of rows), or 0 to aggregate every row.
+	//! Sums and counts are scaled up to estimate them over every row, and a sample_rows value is added after the other
+	//! values that counts the rows in the sample of each cell.
+	double sample_fraction = 0;
+	//! The seed of the sample, if any, so that the same rows are sampled every time
+	optional_idx sample_seed;
+	//! The number of partitions of the detail groups (the rows and the pivot key) that pivot_table_native aggregates
+	//! one at a time, so that only the groups of one partition are aggregated at once (see
+	//! PivotTableSQLBuilder::PartitionPartials), or 1 to aggregate every group at once
+	idx_t partitions = 1;
+	//! Whether simple values may be aggregated in parts that are then merged (see PivotTableSQLBuilder::SimpleValues).
+	//! Not a parameter: it is turned off to retry when a part can not be aggregated (Ex: a sum of timestamps for
+	//! their avg).
+	bool aggregate_in_parts = true;
+
+	//! Whether each value gets its own row (otherwise each value gets its own column)
+	bool ValuesOnRows() const {
+		return values_axis == "rows" && !values.empty();
+	}
+	//! Whether only a sample of the rows is aggregated
+	bool Sampled() const {
+		return sample_fraction > 0;
+	}
+	//! Whether the pivot keys past the top max_pivot_keys - 1 are collapsed into a single Other key
+	bool CollapseKeys() const {
+		return overflow == "other" && max_pivot_keys.IsValid() && !columns.empty();
+	}
+
+	//! The arguments as SQL literals, in the order pivot_table expects them (Ex: to use as a cache key)
+	string ToSQL() const;
+
+	//! Read the arguments from the five list parameters and the named options (values_axis, subtotals,
+	//! grand_totals, ordered, max_rows, max_pivot_keys, overflow, rank_by, approx, sample_fraction, sample_seed and
+	//! partitions). NULL lists are empty, and NULL options keep their default.
+	static PivotTableArguments FromValues(const string &function_name, const vector<Value> &lists,
+	                                      const named_parameter_map_t &options);
+};
+
+//! Builds the SQL statements that pivot_table, pivot_table_show_sql, build_my_enum and pivot_table_native run.
+//! Every statement is appended into a single buffer that is sized up front from the arguments.
+//! The arguments are embedded the same way as the nq, sq and dq macros do it: expressions (values and filters)
+//! can not contain a semicolon, names are double quoted, and strings are single quoted.
+class PivotTableSQLBuilder {
+public:
+	explicit PivotTableSQLBuilder(const PivotTableArguments &args);
+
+	//! Combine the tables by column name (UNION ALL BY NAME) instead of by position (like query_table does).
+	//! This also allows each table to be aggregated separately (see AppendPartials).
+	PivotTableSQLBuilder &CombineByName() {
+		by_name = true;
+		return *this;
+	}
+	//! Read the partial aggregates that pivot_table_materialize stored in a table (see Partials), instead of
+	//! aggregating the tables again
+	PivotTableSQLBuilder &FromPartials(const string &table) {
+		partials_table = table;
+		return *this;
+	}
+	//! Aggregate only the rows of each table that its filter keeps (Ex: the rows appended since the partials were
+	//! stored), and merge them with the stored partials if there are any (see FromPartials)
+	PivotTableSQLBuilder &WithTableFilters(const vector<string> &filters) {
+		per_table_filters = filters;
+		return *this;
+	}
+	//! Read the partial aggregates that pivot_table_native wrote one partition at a time (see PartitionPartials): the
+	//! detail groups are only finalized, and only the totals of every partition are merged
+	PivotTableSQLBuilder &FromPartitions(const string &table) {
+		partials_table = table;
+		partitioned = true;
+		return *this;
+	}
+	//! Aggregate the partitions (see PartitionPartials) from the rows that PartitionScan copied into the table, which
+	//! are already sampled and filtered, instead of from the tables
+	PivotTableSQLBuilder &FromPartitionScan(const string &table) {
+		partition_scan_table = table;
+		return *this;
+	}
+
+	//! Whether every value can be aggregated in parts and the parts merged (a single sum, count, min or max call)
+	bool MergeableValues() const;
+	//! Whether every value is a single sum, count, min, max or avg call. These are aggregated once at the most
+	//! detailed level, and the totals and the tables are merged from there (an avg as its sum and its count).
+	bool SimpleValues() const;
+
+	//! The statement that pivot_table runs: a GROUP BY if there are no columns, otherwise a PIVOT.
+	//! It requires the columns_parameter_enum if there are columns.
+	string PivotTable();
+	//! The statement that pivot_table_native runs: the aggregated data in long format, sorted like pivot_table.
+	//! Columns: dummy_column, rows, [value_names], pivot_columns_key, pivot values, empty values.
+	string NativeInput();
+	//! The statement that pivot_table_materialize stores: the partial aggregates at the most detailed level (the rows
+	//! and the pivot key) of the rows of each table that match its table_filter, merged with the partials that were
+	//! stored before (see FromPartials). Columns: rows, pivot_partial_key, pivot_partial_1, pivot_partial_2, ...
+	string Partials(const vector<string> &table_filters);
+	//! The statement that pivot_table_native runs once when there are partitions, before aggregating them: the rows of
+	//! the tables that match the filters (and the sample), with only the columns (or every column if there are none),
+	//! and the partition of each row's detail group, sorted by partition.
+	//! Columns: columns, pivot_partition
+	string PartitionScan(const vector<string> &columns);
+	//! The statement that pivot_table_native runs for each partition when there are partitions: the partial aggregates
+	//! (see AppendPartials) of the detail groups in the partition, read from the rows that PartitionScan copied (see
+	//! FromPartitionScan), and of every subtotal and grand_total level of those detail groups.
+	//! Each partition is appended to a table, which is then read back with FromPartitions.
+	//! Columns: rows, pivot_grouping_id, pivot_partition, pivot_partial_key, pivot_partial_1, pivot_partial_2, ...
+	string PartitionPartials(idx_t partition);
+	//! The statement that estimates the number of pivot keys with a HyperLogLog sketch (approx_count_distinct),
+	//! reading only the columns and the filters
+	string EstimatePivotKeys();
+	//! The statement that build_my_enum runs: the name of every pivot key that exists in the data, in order.
+	//! It fails if there are more than max_pivot_keys of them.
+	static string Enum(const vector<string> &table_names, const vector<string> &columns, const vector<string> &filters,
+	                   optional_idx max_pivot_keys = optional_idx());
+	//! The statement that pivot_table_batch runs to read the tables once for all of its pivots: the columns (or every
+	//! column if there are none) of the rows that match the filters of at least one of the pivots
+	static string BatchScan(const vector<string> &table_names, const vector<string> &columns,
+	                        const vector<vector<string>> &filters);
+
+	//! No quotes: an expression, with every semicolon replaced so that only a single statement can be generated
+	static string NQ(const string &text);
+	//! Single quotes: a string literal
+	static string SQ(const string &text);
+	//! Double quotes: an identifier
+	static string DQ(const string &text);
+	//! A table name (Ex: my_schema.my_table) as a quoted, possibly qualified, table reference
+	static string TableReference(const string &table_name);
+
+private:
+	bool HasTotals() const {
+		return (args.subtotals || args.grand_totals) && !args.rows.empty();
+	}
+
+	void Append(const string &text) {
+		sql += text;
+	}
+	void AppendQuoted(const vector<string> &list, const string &separator, string (*quote)(const string &));
+	void AppendFiltered();
+	string SampleClause() const;
+
+	void AppendNoColumns();
+	void AppendGroupedCTEs(bool per_table);
+	void AppendEmptyValues();
+	bool CountValue(idx_t index) const;
+	string PivotCell(idx_t index) const;
+	void AppendPivotInputCTEs();
+	void AppendValuesAxisColumns();
+	void AppendTransposedValues();
+	void AppendValuesAxisRows();
+	void AppendTotalsOutput(const string &relation, const vector<string> &extra_cols,
+	                        const string &empty_col = string(), bool sample_rows_last = false);
+
+	void AppendGroupingSets(const string &extra_col);
+	void AppendGroupingId();
+	void AppendRolledUp(const string &row);
+	void AppendRowLabels();
+	void AppendPivotKey(const string &key);
+	string KeyStruct() const;
+	string CollapsedKeyStruct() const;
+	void AppendRankedKeys();
+	void AppendKeyName(const string &key);
+	void AppendKeyLabel(const string &key);
+	string AggregateExpression(const string &value) const;
+	string EstimateExpression(const string &value) const;
+	void AppendValueList(const string &prefix);
+
+	//! Whether each table (or the totals) can be aggregated from partial results that are merged (see AppendPartials)
+	bool AggregatePerTable() const;
+	void AppendPartials(const vector<string> &table_filters, bool aggregate_tables);
+	void AppendPartialValueList();
+	void AppendMergedValueList(const string &prefix);
+	void AppendMergedPartialList();
+	void AppendFinalizedValueList(const string &prefix);
+	void AppendPartitionsGroupedByKey();
+
+	const PivotTableArguments &args;
+	bool by_name = false;
+	string partials_table;
+	vector<string> per_table_filters;
+	bool partitioned = false;
+	string partition_scan_table;
+	string sql;
+};
+
+//! pivot_table_sql(table_names, values, rows, columns, filters, values_axis, subtotals, grand_totals[, ordered,
+//! max_rows[, approx, sample_fraction[, sample_seed]]]) returns the statement that pivot_table runs.
+//! pivot_table_enum_sql(table_names, columns, filters[, max_pivot_keys]) returns the statement that build_my_enum runs.
+struct PivotTableSQLFunction {
+	static ScalarFunctionSet GetFunction();
+	static ScalarFunctionSet GetEnumFunction();
+};
+
+} // namespace duckdb
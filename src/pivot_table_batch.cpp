@@ -0,0 +1,316 @@
+#include "pivot_table_batch.hpp"
+#include "pivot_table_cache.hpp"
+#include "pivot_table_native.hpp"
+#include "pivot_table_sql.hpp"
+
+#include "duckdb/common/case_insensitive_map.hpp"
+#include "duckdb/common/exception.hpp"
+#include "duckdb/common/numeric_utils.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/function/table_function.hpp"
+#include "duckdb/main/appender.hpp"
+#include "duckdb/main/connection.hpp"
+#include "duckdb/main/materialized_query_result.hpp"
+#include "duckdb/main/prepared_statement.hpp"
+#include "duckdb/parser/qualified_name.hpp"
+
+namespace duckdb {
+
+//! The temporary table that keeps what the tables were read for, on the separate connection that the pivots run on
+static const char *const BATCH_SCAN_TABLE = "pivot_table_batch_scan";
+
+static const char *const SPEC_LISTS[] = {"values", "rows", "columns", "filters"};
+
+static unique_ptr<MaterializedQueryResult> Run(Connection &con, const string &sql, vector<Value> parameters = {}) {
+	auto prepared = con.Prepare(sql);
+	if (prepared->HasError()) {
+		prepared->GetErrorObject().Throw();
+	}
+	auto result = prepared->Execute(parameters, false);
+	if (result->HasError()) {
+		result->ThrowError();
+	}
+	return unique_ptr_cast<QueryResult, MaterializedQueryResult>(std::move(result));
+}
+
+//===--------------------------------------------------------------------===//
+// Specs
+//===--------------------------------------------------------------------===//
+//! A pivot of pivot_table_batch, and the table that it is written to
+struct PivotTableBatchSpec {
+	string name;
+	PivotTableArguments args;
+};
+
+//! What was written for a spec
+struct PivotTableBatchResult {
+	string name;
+	idx_t row_count;
+	idx_t column_count;
+};
+
+static vector<PivotTableBatchSpec> ParseSpecs(const Value &table_names, const Value &specs) {
+	if (specs.IsNull() || specs.type().id() != LogicalTypeId::LIST ||
+	    ListType::GetChildType(specs.type()).id() != LogicalTypeId::STRUCT) {
+		throw InvalidInputException("pivot_table_batch: specs must be a list of structs (Ex: [{name: 'by_region', "
+		                            "values: ['sum(amount)'], rows: ['region'], columns: ['year']}])");
+	}
+	auto &fields = StructType::GetChildTypes(ListType::GetChildType(specs.type()));
+	// Every field is checked, so that a misspelled option (Ex: subtotal) is not silently ignored
+	auto native_options = PivotTableNativeFunction::GetFunction().named_parameters;
+	for (auto &field : fields) {
+		auto is_list = false;
+		for (auto list : SPEC_LISTS) {
+			is_list = is_list || StringUtil::CIEquals(field.first, list);
+		}
+		if (!is_list && !StringUtil::CIEquals(field.first, "name") && !native_options.count(field.first)) {
+			throw InvalidInputException("pivot_table_batch: unknown spec field '%s' (a spec has a name, the values, "
+			                            "rows, columns and filters lists, and the named parameters of "
+			                            "pivot_table_native)",
+			                            field.first);
+		}
+	}
+	vector<PivotTableBatchSpec> result;
+	case_insensitive_set_t names;
+	for (auto &spec_value : ListValue::GetChildren(specs)) {
+		if (spec_value.IsNull()) {
+			throw InvalidInputException("pivot_table_batch: specs can not contain NULL");
+		}
+		// The lists are the parameters of pivot_table_native (a missing list is empty), and the other fields are its
+		// named options
+		PivotTableBatchSpec spec;
+		vector<Value> lists {table_names, Value(), Value(), Value(), Value()};
+		named_parameter_map_t options;
+		auto &values = StructValue::GetChildren(spec_value);
+		for (idx_t i = 0; i < fields.size(); i++) {
+			auto field = StringUtil::Lower(fields[i].first);
+			if (field == "name") {
+				spec.name = values[i].IsNull() ? string() : values[i].ToString();
+				continue;
+			}
+			bool is_list = false;
+			for (idx_t l = 0; l < 4; l++) {
+				if (field == SPEC_LISTS[l]) {
+					if (fields[i].second.id() != LogicalTypeId::LIST) {
+						throw InvalidInputException("pivot_table_batch: the %s of a spec must be a list", field);
+					}
+					lists[1 + l] = values[i];
+					is_list = true;
+				}
+			}
+			if (!is_list) {
+				options[fields[i].first] = values[i];
+			}
+		}
+		if (spec.name.empty()) {
+			throw InvalidInputException(
+			    "pivot_table_batch: every spec needs a name (the table that its pivot is written to)");
+		}
+		if (!names.insert(spec.name).second) {
+			throw InvalidInputException("pivot_table_batch: there is more than one spec named '%s'", spec.name);
+		}
+		if (!QualifiedName::Parse(spec.name).catalog.empty()) {
+			throw InvalidInputException("pivot_table_batch: the result table '%s' can not be in another database",
+			                            spec.name);
+		}
+		spec.args = PivotTableArguments::FromValues("pivot_table_batch", lists, options);
+		result.push_back(std::move(spec));
+	}
+	if (result.empty()) {
+		throw InvalidInputException("pivot_table_batch: specs can not be empty");
+	}
+	return result;
+}
+
+//===--------------------------------------------------------------------===//
+// Batch
+//===--------------------------------------------------------------------===//
+//! Read the tables once, into a temporary table: only the columns that the pivots refer to, and only the rows that
+//! match the filters of at least one of them. The rows that are kept are copied (in memory, spilling to disk when
+//! needed), and every pivot then scans that copy, so a batch costs one scan of the tables, one copy of the rows that
+//! are kept, and one scan of that copy per spec. The pivots can not share a single scan of the tables instead, as
+//! each one is a separate query with its own result columns.
+static void ReadTables(Connection &con, const vector<string> &table_names, const vector<PivotTableBatchSpec> &specs) {
+	vector<string> referenced;
+	vector<vector<string>> filters;
+	bool complete = true;
+	for (auto &spec : specs) {
+		complete = PivotTableReferencedColumns(spec.args, referenced) && complete;
+		filters.push_back(spec.args.filters);
+	}
+	vector<string> columns;
+	if (complete) {
+		columns = PivotTableScannedColumns(con, table_names, referenced);
+	}
+	Run(con, "CREATE OR REPLACE TEMP TABLE " + string(BATCH_SCAN_TABLE) + " AS\n" +
+	             PivotTableSQLBuilder::BatchScan(table_names, columns, filters));
+}
+
+static void CreateMetadataTable(Connection &con) {
+	Run(con, "CREATE TABLE IF NOT EXISTS pivot_table_batch_results (name VARCHAR PRIMARY KEY)");
+}
+
+//! The pivots are written with CREATE OR REPLACE TABLE, so refuse to replace a table that pivot_table_batch did not
+//! write
+static void CheckOwnedTable(Connection &con, const string &name) {
+	auto table = QualifiedName::Parse(name);
+	auto existing = Run(con,
+	                    "SELECT count(*) FROM duckdb_tables() WHERE database_name = current_database() "
+	                    "AND schema_name = coalesce($1, current_schema()) AND lower(table_name) = lower($2)",
+	                    {table.schema.empty() ? Value(LogicalType::VARCHAR) : Value(table.schema), Value(table.name)});
+	if (existing->GetValue(0, 0).GetValue<int64_t>() == 0) {
+		return;
+	}
+	auto recorded = Run(con, "SELECT count(*) FROM pivot_table_batch_results WHERE name = $1", {Value(name)});
+	if (recorded->GetValue(0, 0).GetValue<int64_t>() == 0) {
+		throw InvalidInputException("pivot_table_batch: the table '%s' already exists and was not written by "
+		                            "pivot_table_batch, so it is not replaced",
+		                            name);
+	}
+}
+
+static void CreateResultTable(Connection &con, const string &table_name, const vector<LogicalType> &types,
+                              const vector<string> &names) {
+	string sql = "CREATE OR REPLACE TABLE " + PivotTableSQLBuilder::TableReference(table_name) + " (";
+	for (idx_t i = 0; i < types.size(); i++) {
+		sql += (i == 0 ? "" : ", ") + PivotTableSQLBuilder::DQ(names[i]) + " " + types[i].ToString();
+	}
+	Run(con, sql + ")");
+	Run(con, "INSERT OR REPLACE INTO pivot_table_batch_results VALUES ($1)", {Value(table_name)});
+}
+
+//! Compute the pivot of a spec from its table_names (the rows that were read, or the tables themselves), and write it
+//! to its table
+static PivotTableBatchResult WriteSpec(Connection &con, PivotTableBatchSpec &spec) {
+	auto table = QualifiedName::Parse(spec.name);
+	auto schema = table.schema.empty() ? string(DEFAULT_SCHEMA) : table.schema;
+	auto &args = spec.args;
+	PivotTableBatchResult result {spec.name, 0, 0};
+	if (args.columns.empty()) {
+		// Without columns there is nothing to pivot, like in pivot_table_native
+		auto output = Run(con, "FROM (" + PivotTableSQLBuilder(args).CombineByName().PivotTable() +
+		                           ") SELECT * EXCLUDE (dummy_column)");
+		CreateResultTable(con, spec.name, output->types, output->names);
+		Appender appender(con, schema, table.name);
+		for (auto &chunk : output->Collection().Chunks()) {
+			appender.AppendDataChunk(chunk);
+		}
+		appender.Close();
+		result.row_count = output->RowCount();
+		result.column_count = output->types.size();
+		return result;
+	}
+	unique_ptr<MaterializedQueryResult> input;
+	if (args.partitions > 1) {
+		input = con.Query(PivotTableNativeFunction::WritePartitions(con, "pivot_table_batch", args));
+		PivotTableNativeFunction::DropPartitions(con);
+	} else {
+		input = con.Query(PivotTableSQLBuilder(args).CombineByName().NativeInput());
+	}
+	if (input->HasError() && args.aggregate_in_parts && args.partitions <= 1 &&
+	    PivotTableIsBindError(input->GetErrorObject())) {
+		// A simple value can fail to be aggregated in parts (see PivotTableNativeBind)
+		args.aggregate_in_parts = false;
+		input = con.Query(PivotTableSQLBuilder(args).CombineByName().NativeInput());
+	}
+	if (input->HasError()) {
+		input->ThrowError();
+	}
+	vector<LogicalType> types;
+	vector<string> names;
+	auto bind_data = PivotTableNativeFunction::BindInput(args, std::move(input), types, names);
+	CreateResultTable(con, spec.name, types, names);
+	Appender appender(con, schema, table.name);
+	result.row_count = PivotTableNativeFunction::AppendOutput(*bind_data, types, appender);
+	result.column_count = types.size();
+	appender.Close();
+	return result;
+}
+
+//===--------------------------------------------------------------------===//
+// pivot_table_batch
+//===--------------------------------------------------------------------===//
+struct PivotTableBatchBindData : public TableFunctionData {
+	vector<PivotTableBatchResult> results;
+};
+
+struct PivotTableBatchState : public GlobalTableFunctionState {
+	idx_t offset = 0;
+};
+
+static unique_ptr<FunctionData> PivotTableBatchBind(ClientContext &context, TableFunctionBindInput &input,
+                                                    vector<LogicalType> &return_types, vector<string> &names) {
+	auto specs = ParseSpecs(input.inputs[0], input.inputs[1]);
+	auto table_names = specs[0].args.table_names;
+	if (table_names.empty()) {
+		throw InvalidInputException("pivot_table_batch: the table_names parameter can not be empty");
+	}
+	PivotTablePlanCache::CheckSnapshot(context, input, "pivot_table_batch", table_names);
+
+	// Every pivot is computed and written while binding, on the same separate connection that pivot_table_native
+	// runs on, in a single transaction. The tables are scanned once, and each pivot aggregates the (usually much
+	// smaller) rows and columns that were read, with its own filters. A single pivot reads the tables directly, as
+	// copying the rows would only add to the scan.
+	auto read_tables = specs.size() > 1;
+	auto result = make_uniq<PivotTableBatchBindData>();
+	auto plan_cache = PivotTablePlanCache::Get(context);
+	lock_guard<mutex> guard(plan_cache->lock);
+	auto &con = plan_cache->GetConnection(context);
+	con.BeginTransaction();
+	try {
+		CreateMetadataTable(con);
+		for (auto &spec : specs) {
+			CheckOwnedTable(con, spec.name);
+		}
+		if (read_tables) {
+			ReadTables(con, table_names, specs);
+		}
+		for (auto &spec : specs) {
+			if (read_tables) {
+				spec.args.table_names = {BATCH_SCAN_TABLE};
+			}
+			result->results.push_back(WriteSpec(con, spec));
+		}
+		if (read_tables) {
+			Run(con, "DROP TABLE " + string(BATCH_SCAN_TABLE));
+		}
+		con.Commit();
+	} catch (std::exception &) {
+		con.Rollback();
+		throw;
+	}
+
+	names.emplace_back("name");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	names.emplace_back("row_count");
+	return_types.emplace_back(LogicalType::BIGINT);
+	names.emplace_back("column_count");
+	return_types.emplace_back(LogicalType::BIGINT);
+	return std::move(result);
+}
+
+static unique_ptr<GlobalTableFunctionState> PivotTableBatchInit(ClientContext &context,
+                                                                TableFunctionInitInput &input) {
+	return make_uniq<PivotTableBatchState>();
+}
+
+static void PivotTableBatchScan(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &bind_data = data_p.bind_data->Cast<PivotTableBatchBindData>();
+	auto &state = data_p.global_state->Cast<PivotTableBatchState>();
+	idx_t count = 0;
+	while (state.offset < bind_data.results.size() && count < STANDARD_VECTOR_SIZE) {
+		auto &result = bind_data.results[state.offset++];
+		output.SetValue(0, count, Value(result.name));
+		output.SetValue(1, count, Value::BIGINT(NumericCast<int64_t>(result.row_count)));
+		output.SetValue(2, count, Value::BIGINT(NumericCast<int64_t>(result.column_count)));
+		count++;
+	}
+	output.SetCardinality(count);
+}
+
+TableFunction PivotTableBatchFunction::GetFunction() {
+	return TableFunction("pivot_table_batch", {LogicalType::LIST(LogicalType::VARCHAR), LogicalType::ANY},
+	                     PivotTableBatchScan, PivotTableBatchBind, PivotTableBatchInit);
+}
+
+} // namespace duckdb
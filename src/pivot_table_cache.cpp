@@ -0,0 +1,287 @@
+#include "pivot_table_cache.hpp"
+
+#include "duckdb/catalog/catalog.hpp"
+#include "duckdb/catalog/catalog_entry/table_catalog_entry.hpp"
+#include "duckdb/common/exception.hpp"
+#include "duckdb/common/numeric_utils.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/function/table_function.hpp"
+#include "duckdb/main/client_config.hpp"
+#include "duckdb/main/client_context.hpp"
+#include "duckdb/main/connection.hpp"
+#include "duckdb/main/materialized_query_result.hpp"
+#include "duckdb/main/prepared_statement.hpp"
+#include "duckdb/parser/expression/constant_expression.hpp"
+#include "duckdb/parser/expression/parameter_expression.hpp"
+#include "duckdb/parser/parsed_expression_iterator.hpp"
+#include "duckdb/parser/parser.hpp"
+#include "duckdb/parser/qualified_name.hpp"
+#include "duckdb/planner/binder.hpp"
+#include "duckdb/transaction/transaction_context.hpp"
+
+#include <algorithm>
+
+namespace duckdb {
+
+//===--------------------------------------------------------------------===//
+// Generated SQL
+//===--------------------------------------------------------------------===//
+shared_ptr<PivotTableSQLCache> PivotTableSQLCache::Get(ClientContext &context) {
+	return ObjectCache::GetObjectCache(context).GetOrCreate<PivotTableSQLCache>(ObjectType());
+}
+
+string PivotTableSQLCache::GetSQL(ClientContext &context, const PivotTableArguments &args) {
+	auto arguments = args.ToSQL();
+	{
+		lock_guard<mutex> guard(lock);
+		auto entry = sql.Get(arguments);
+		if (entry) {
+			return *entry;
+		}
+	}
+	// pivot_table_native combines the tables by name, so tables with their columns in another order line up
+	auto generated = PivotTableSQLBuilder(args).CombineByName().NativeInput();
+
+	// The generated SQL is run directly instead of through the query function, so apply the same restriction:
+	// only a single SELECT statement may be run.
+	Parser parser(context.GetParserOptions());
+	parser.ParseQuery(generated);
+	if (parser.statements.size() != 1 || parser.statements[0]->type != StatementType::SELECT_STATEMENT) {
+		throw InvalidInputException("pivot_table_native: the arguments must generate a single SELECT statement");
+	}
+
+	lock_guard<mutex> guard(lock);
+	sql.Put(arguments, generated);
+	return generated;
+}
+
+//===--------------------------------------------------------------------===//
+// Prepared plans
+//===--------------------------------------------------------------------===//
+shared_ptr<PivotTablePlanCache> PivotTablePlanCache::Get(ClientContext &context) {
+	return context.registered_state->GetOrCreate<PivotTablePlanCache>("pivot_table_plan_cache");
+}
+
+//! The session state of the client that changes how a pivot binds or what it returns, as text: the search path
+//! (USE and SET search_path), the extension settings (Ex: TimeZone), the variables and integer_division
+static string SessionKey(ClientContext &context, const string &search_path) {
+	auto &config = ClientConfig::GetConfig(context);
+	vector<string> entries;
+	for (auto &entry : config.set_variables) {
+		entries.push_back("SET " + entry.first + " = " + entry.second.ToSQLString());
+	}
+	for (auto &entry : config.user_variables) {
+		entries.push_back("SET VARIABLE " + entry.first + " = " + entry.second.ToSQLString());
+	}
+	std::sort(entries.begin(), entries.end());
+	entries.push_back("SET integer_division = " + string(config.integer_division ? "true" : "false"));
+	entries.push_back("SET search_path = " + Value(search_path).ToSQLString());
+	return StringUtil::Join(entries, "; ");
+}
+
+Connection &PivotTablePlanCache::GetConnection(ClientContext &context) {
+	if (!connection) {
+		connection = make_uniq<Connection>(*context.db);
+	}
+	// The connection runs the pivots of this client, so it has to resolve names and evaluate expressions like the
+	// client does: copy the session state of the client before each use. The search path is only set when it changed,
+	// since that runs a statement.
+	Value search_path_value;
+	string search_path;
+	if (context.TryGetCurrentSetting("search_path", search_path_value) != SettingLookupResult::NOT_FOUND &&
+	    !search_path_value.IsNull()) {
+		search_path = search_path_value.ToString();
+	}
+	auto &source = ClientConfig::GetConfig(context);
+	auto &target = ClientConfig::GetConfig(*connection->context);
+	target.set_variables = source.set_variables;
+	target.user_variables = source.user_variables;
+	target.integer_division = source.integer_division;
+	if (search_path != connection_search_path) {
+		auto result = connection->Query(search_path.empty() ? "RESET search_path"
+		                                                    : "SET search_path = " + Value(search_path).ToSQLString());
+		if (result->HasError()) {
+			result->ThrowError();
+		}
+		connection_search_path = search_path;
+	}
+	session_key = SessionKey(context, search_path);
+	return *connection;
+}
+
+void PivotTablePlanCache::CheckSnapshot(ClientContext &context, TableFunctionBindInput &input,
+                                        const string &function_name, const vector<string> &table_names) {
+	if (!context.transaction.IsAutoCommit()) {
+		throw InvalidInputException("%s can not run inside a transaction: it reads the tables on a separate "
+		                            "connection, which does not see the changes of the transaction. Run it after "
+		                            "COMMIT, or use pivot_table instead",
+		                            function_name);
+	}
+	for (auto &table_name : table_names) {
+		optional_ptr<CatalogEntry> table;
+		try {
+			// Views are looked up with the tables
+			auto name = QualifiedName::Parse(table_name);
+			table = Catalog::GetEntry(context, CatalogType::TABLE_ENTRY, name.catalog, name.schema, name.name,
+			                          OnEntryNotFound::RETURN_NULL);
+		} catch (std::exception &) {
+			// Not a table (Ex: a Parquet file), the generated SQL reads it
+			table = nullptr;
+		}
+		if (table && table->temporary) {
+			throw InvalidInputException("%s can not read the temporary table or view '%s': it reads the tables on a "
+			                            "separate connection, which does not see the temporary tables and views of "
+			                            "this one. Use pivot_table instead",
+			                            function_name, table_name);
+		}
+	}
+	if (input.binder) {
+		input.binder->SetAlwaysRequireRebind();
+	}
+}
+
+unique_ptr<MaterializedQueryResult> PivotTablePlanCache::Execute(ClientContext &context,
+                                                                 const PivotTableArguments &args,
+                                                                 vector<Value> &parameters) {
+	lock_guard<mutex> guard(lock);
+	auto &con = GetConnection(context);
+	// A plan is bound with the search path and the settings of the client (see GetConnection)
+	auto arguments = args.ToSQL() + "\n" + session_key;
+	auto entry = plans.Get(arguments);
+	if (entry) {
+		auto result = (*entry)->Execute(parameters, false);
+		if (!result->HasError()) {
+			return unique_ptr_cast<QueryResult, MaterializedQueryResult>(std::move(result));
+		}
+		if (!PivotTableIsBindError(result->GetErrorObject())) {
+			// The plan ran and failed (Ex: a conversion error in the data), preparing it again would not help
+			result->ThrowError();
+		}
+		// The plan can fail to rebind after a catalog change (Ex: a table was re-created with other column types),
+		// so drop it and prepare the statement again
+		plans.Erase(arguments);
+	}
+
+	string sql;
+	try {
+		sql = PivotTableSQLCache::Get(context)->GetSQL(context, args);
+	} catch (std::exception &ex) {
+		return make_uniq<MaterializedQueryResult>(ErrorData(ex));
+	}
+	auto prepared = shared_ptr<PreparedStatement>(con.Prepare(sql).release());
+	if (prepared->HasError()) {
+		return make_uniq<MaterializedQueryResult>(prepared->GetErrorObject());
+	}
+	plans.Put(arguments, prepared);
+	auto result = prepared->Execute(parameters, false);
+	if (result->HasError()) {
+		result->ThrowError();
+	}
+	return unique_ptr_cast<QueryResult, MaterializedQueryResult>(std::move(result));
+}
+
+//===--------------------------------------------------------------------===//
+// Filter parameters
+//===--------------------------------------------------------------------===//
+static void ReplaceConstants(unique_ptr<ParsedExpression> &expr, vector<Value> &parameters) {
+	if (expr->GetExpressionClass() == ExpressionClass::CONSTANT) {
+		parameters.push_back(expr->Cast<ConstantExpression>().value);
+		auto parameter = make_uniq<ParameterExpression>();
+		parameter->identifier = to_string(parameters.size());
+		expr = std::move(parameter);
+		return;
+	}
+	ParsedExpressionIterator::EnumerateChildren(
+	    *expr, [&](unique_ptr<ParsedExpression> &child) { ReplaceConstants(child, parameters); });
+}
+
+bool PivotTableIsBindError(const ErrorData &error) {
+	return error.Type() == ExceptionType::BINDER || error.Type() == ExceptionType::PARAMETER_NOT_RESOLVED;
+}
+
+vector<string> PivotTableParameterizeFilters(const vector<string> &filters, vector<Value> &parameters) {
+	vector<string> result;
+	for (auto &filter : filters) {
+		vector<unique_ptr<ParsedExpression>> expressions;
+		try {
+			expressions = Parser::ParseExpressionList(filter);
+		} catch (std::exception &) {
+			// Leave anything that does not parse on its own as it is, the generated SQL will report the error
+			result.push_back(filter);
+			continue;
+		}
+		if (expressions.size() != 1) {
+			result.push_back(filter);
+			continue;
+		}
+		ReplaceConstants(expressions[0], parameters);
+		result.push_back(expressions[0]->ToString());
+	}
+	return result;
+}
+
+//===--------------------------------------------------------------------===//
+// pivot_table_cache_stats
+//===--------------------------------------------------------------------===//
+struct PivotTableCacheStatsState : public GlobalTableFunctionState {
+	bool finished = false;
+};
+
+static unique_ptr<FunctionData> PivotTableCacheStatsBind(ClientContext &context, TableFunctionBindInput &input,
+                                                         vector<LogicalType> &return_types, vector<string> &names) {
+	names.emplace_back("cache");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	names.emplace_back("entries");
+	return_types.emplace_back(LogicalType::BIGINT);
+	names.emplace_back("capacity");
+	return_types.emplace_back(LogicalType::BIGINT);
+	names.emplace_back("hits");
+	return_types.emplace_back(LogicalType::BIGINT);
+	names.emplace_back("misses");
+	return_types.emplace_back(LogicalType::BIGINT);
+	names.emplace_back("evictions");
+	return_types.emplace_back(LogicalType::BIGINT);
+	return nullptr;
+}
+
+static unique_ptr<GlobalTableFunctionState> PivotTableCacheStatsInit(ClientContext &context,
+                                                                     TableFunctionInitInput &input) {
+	return make_uniq<PivotTableCacheStatsState>();
+}
+
+template <class T>
+static void AddStatsRow(DataChunk &output, idx_t row, const string &name, const PivotTableLRUCache<T> &cache) {
+	output.SetValue(0, row, Value(name));
+	output.SetValue(1, row, Value::BIGINT(NumericCast<int64_t>(cache.Size())));
+	output.SetValue(2, row, Value::BIGINT(NumericCast<int64_t>(cache.Capacity())));
+	output.SetValue(3, row, Value::BIGINT(NumericCast<int64_t>(cache.stats.hits)));
+	output.SetValue(4, row, Value::BIGINT(NumericCast<int64_t>(cache.stats.misses)));
+	output.SetValue(5, row, Value::BIGINT(NumericCast<int64_t>(cache.stats.evictions)));
+}
+
+static void PivotTableCacheStatsScan(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &state = data_p.global_state->Cast<PivotTableCacheStatsState>();
+	if (state.finished) {
+		return;
+	}
+	// The generated SQL is shared by the whole database, the plans belong to the current connection
+	auto sql_cache = PivotTableSQLCache::Get(context);
+	{
+		lock_guard<mutex> guard(sql_cache->lock);
+		AddStatsRow(output, 0, "sql", sql_cache->sql);
+	}
+	auto plan_cache = PivotTablePlanCache::Get(context);
+	{
+		lock_guard<mutex> guard(plan_cache->lock);
+		AddStatsRow(output, 1, "plan", plan_cache->plans);
+	}
+	output.SetCardinality(2);
+	state.finished = true;
+}
+
+TableFunction PivotTableCacheStatsFunction::GetFunction() {
+	return TableFunction("pivot_table_cache_stats", {}, PivotTableCacheStatsScan, PivotTableCacheStatsBind,
+	                     PivotTableCacheStatsInit);
+}
+
+} // namespace duckdb
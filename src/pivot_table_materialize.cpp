@@ -0,0 +1,311 @@
+#include "pivot_table_materialize.hpp"
+#include "pivot_table_cache.hpp"
+#include "pivot_table_native.hpp"
+#include "pivot_table_sql.hpp"
+
+#include "duckdb/common/exception.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/function/table_function.hpp"
+#include "duckdb/main/connection.hpp"
+#include "duckdb/main/materialized_query_result.hpp"
+#include "duckdb/main/prepared_statement.hpp"
+#include "duckdb/parser/qualified_name.hpp"
+
+namespace duckdb {
+
+//===--------------------------------------------------------------------===//
+// Metadata
+//===--------------------------------------------------------------------===//
+//! A materialized pivot, as stored in the pivot_table_materializations table
+struct PivotTableMaterialization {
+	//! The table that holds the partial aggregates (see PivotTableSQLBuilder::Partials)
+	string name;
+	PivotTableArguments args;
+	//! The column that increases as rows are appended, or empty to use the rowid
+	string watermark;
+	//! The highest watermark of each table that has been folded in (NULL if none yet)
+	vector<Value> high_watermarks;
+
+	string WatermarkColumn() const {
+		return watermark.empty() ? "rowid" : PivotTableSQLBuilder::DQ(watermark);
+	}
+};
+
+static unique_ptr<MaterializedQueryResult> Run(Connection &con, const string &sql, vector<Value> parameters = {}) {
+	auto prepared = con.Prepare(sql);
+	if (prepared->HasError()) {
+		prepared->GetErrorObject().Throw();
+	}
+	auto result = prepared->Execute(parameters, false);
+	if (result->HasError()) {
+		result->ThrowError();
+	}
+	return unique_ptr_cast<QueryResult, MaterializedQueryResult>(std::move(result));
+}
+
+static Value StringListValue(const vector<string> &list) {
+	vector<Value> children;
+	for (auto &entry : list) {
+		children.emplace_back(entry);
+	}
+	return Value::LIST(LogicalType::VARCHAR, std::move(children));
+}
+
+static void CreateMetadataTable(Connection &con) {
+	Run(con, "CREATE TABLE IF NOT EXISTS pivot_table_materializations (name VARCHAR PRIMARY KEY, "
+	         "table_names VARCHAR[], \"values\" VARCHAR[], \"rows\" VARCHAR[], \"columns\" VARCHAR[], "
+	         "filters VARCHAR[], values_axis VARCHAR, subtotals BOOLEAN, grand_totals BOOLEAN, watermark VARCHAR, "
+	         "high_watermarks VARCHAR[])");
+}
+
+static bool MetadataTableExists(Connection &con) {
+	auto result = Run(con, "SELECT count(*) FROM duckdb_tables() WHERE database_name = current_database() AND "
+	                       "schema_name = current_schema() AND table_name = 'pivot_table_materializations'");
+	return result->GetValue(0, 0).GetValue<int64_t>() > 0;
+}
+
+static void SaveMetadata(Connection &con, const PivotTableMaterialization &materialization) {
+	auto &args = materialization.args;
+	Run(con, "INSERT OR REPLACE INTO pivot_table_materializations VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11)",
+	    {Value(materialization.name), StringListValue(args.table_names), StringListValue(args.values),
+	     StringListValue(args.rows), StringListValue(args.columns), StringListValue(args.filters),
+	     Value(args.values_axis), Value::BOOLEAN(args.subtotals), Value::BOOLEAN(args.grand_totals),
+	     materialization.watermark.empty() ? Value(LogicalType::VARCHAR) : Value(materialization.watermark),
+	     Value::LIST(LogicalType::VARCHAR, materialization.high_watermarks)});
+}
+
+static PivotTableMaterialization LoadMetadata(Connection &con, const string &name,
+                                              const named_parameter_map_t &options) {
+	if (!MetadataTableExists(con)) {
+		throw InvalidInputException("pivot_table_refresh: there is no materialized pivot named '%s'", name);
+	}
+	auto result = Run(con,
+	                  "SELECT table_names, \"values\", \"rows\", \"columns\", filters, values_axis, subtotals, "
+	                  "grand_totals, watermark, high_watermarks FROM pivot_table_materializations WHERE name = $1",
+	                  {Value(name)});
+	if (result->RowCount() == 0) {
+		throw InvalidInputException("pivot_table_refresh: there is no materialized pivot named '%s'", name);
+	}
+	PivotTableMaterialization materialization;
+	materialization.name = name;
+	vector<Value> lists;
+	for (idx_t i = 0; i < 5; i++) {
+		lists.push_back(result->GetValue(i, 0));
+	}
+	// The stored options, followed by the options of this call that only change the output (ordered and max_rows)
+	named_parameter_map_t stored_options = options;
+	stored_options["values_axis"] = result->GetValue(5, 0);
+	stored_options["subtotals"] = result->GetValue(6, 0);
+	stored_options["grand_totals"] = result->GetValue(7, 0);
+	materialization.args = PivotTableArguments::FromValues("pivot_table_refresh", lists, stored_options);
+	auto watermark = result->GetValue(8, 0);
+	if (!watermark.IsNull()) {
+		materialization.watermark = StringValue::Get(watermark);
+	}
+	materialization.high_watermarks = ListValue::GetChildren(result->GetValue(9, 0));
+	return materialization;
+}
+
+//! The partials are first stored with CREATE OR REPLACE TABLE, so refuse to replace a table that is not a materialized
+//! pivot (Ex: one of the tables that are pivoted)
+static void CheckOwnedTable(Connection &con, const string &name) {
+	auto table = QualifiedName::Parse(name);
+	auto existing = Run(con,
+	                    "SELECT count(*) FROM duckdb_tables() WHERE database_name = coalesce($1, current_database()) "
+	                    "AND schema_name = coalesce($2, current_schema()) AND lower(table_name) = lower($3)",
+	                    {table.catalog.empty() ? Value(LogicalType::VARCHAR) : Value(table.catalog),
+	                     table.schema.empty() ? Value(LogicalType::VARCHAR) : Value(table.schema), Value(table.name)});
+	if (existing->GetValue(0, 0).GetValue<int64_t>() == 0) {
+		return;
+	}
+	if (MetadataTableExists(con)) {
+		auto recorded = Run(con, "SELECT count(*) FROM pivot_table_materializations WHERE name = $1", {Value(name)});
+		if (recorded->GetValue(0, 0).GetValue<int64_t>() > 0) {
+			return;
+		}
+	}
+	throw InvalidInputException("pivot_table_materialize: the table '%s' already exists and is not a materialized "
+	                            "pivot, so it is not replaced",
+	                            name);
+}
+
+//===--------------------------------------------------------------------===//
+// Refresh
+//===--------------------------------------------------------------------===//
+//! The filter of each table that keeps its rows above its high watermark, up to its highest watermark now, which
+//! becomes its new high watermark. The caller reads the rows in the same transaction, so rows that are appended
+//! meanwhile are left for the next refresh.
+static vector<string> AppendedRowFilters(Connection &con, PivotTableMaterialization &materialization) {
+	auto &args = materialization.args;
+	auto column = materialization.WatermarkColumn();
+	vector<string> table_filters;
+	for (idx_t t = 0; t < args.table_names.size(); t++) {
+		auto &high_watermark = materialization.high_watermarks[t];
+		auto table = PivotTableSQLBuilder::TableReference(args.table_names[t]);
+		auto new_high_watermark = Run(con, "SELECT max(" + column + ")::VARCHAR FROM " + table)->GetValue(0, 0);
+		if (new_high_watermark.IsNull()) {
+			// The table is still empty
+			table_filters.push_back("false");
+			continue;
+		}
+		// The watermarks are stored as strings, and cast back to the type of the column when compared to it
+		string filter = column + " <= " + PivotTableSQLBuilder::SQ(StringValue::Get(new_high_watermark));
+		if (!high_watermark.IsNull()) {
+			filter = column + " > " + PivotTableSQLBuilder::SQ(StringValue::Get(high_watermark)) + " AND " + filter;
+		}
+		table_filters.push_back(filter);
+		high_watermark = new_high_watermark;
+	}
+	return table_filters;
+}
+
+//! Store the partials of the rows that the filters keep (see AppendedRowFilters) and the new watermarks, once the query
+//! runs. The first time, the table is created. A refresh only inserts the partials of the appended rows, so it writes
+//! as much as it aggregates: the partials of a group that was already stored are merged when the pivot is read.
+static void StorePartials(ClientContext &context, const PivotTableMaterialization &materialization,
+                          const vector<Value> &previous_high_watermarks, const vector<string> &table_filters,
+                          bool stored) {
+	auto plan_cache = PivotTablePlanCache::Get(context);
+	lock_guard<mutex> guard(plan_cache->lock);
+	auto &con = plan_cache->GetConnection(context);
+	auto table = PivotTableSQLBuilder::TableReference(materialization.name);
+	auto partials = PivotTableSQLBuilder(materialization.args).Partials(table_filters);
+	con.BeginTransaction();
+	try {
+		CreateMetadataTable(con);
+		if (stored) {
+			// Another refresh may have stored the same rows since this one was bound
+			auto current = LoadMetadata(con, materialization.name, named_parameter_map_t()).high_watermarks;
+			bool same = current.size() == previous_high_watermarks.size();
+			for (idx_t t = 0; same && t < current.size(); t++) {
+				same = Value::NotDistinctFrom(current[t], previous_high_watermarks[t]);
+			}
+			if (!same) {
+				throw InvalidInputException("pivot_table_refresh: '%s' was refreshed by another query after this one was "
+				                            "planned, run it again",
+				                            materialization.name);
+			}
+			Run(con, "INSERT INTO " + table + " BY NAME\n" + partials);
+		} else {
+			CheckOwnedTable(con, materialization.name);
+			Run(con, "CREATE OR REPLACE TABLE " + table + " AS\n" + partials);
+		}
+		SaveMetadata(con, materialization);
+		con.Commit();
+	} catch (std::exception &) {
+		con.Rollback();
+		throw;
+	}
+}
+
+static unique_ptr<FunctionData> Refresh(ClientContext &context, PivotTableMaterialization &materialization,
+                                        bool stored, vector<LogicalType> &return_types, vector<string> &names) {
+	// The pivot is read on the same separate connection that pivot_table_native runs on: the stored partials (if any)
+	// merged with the partials of the appended rows. Nothing is written while binding, so binding the query (Ex:
+	// EXPLAIN or PREPARE) does not refresh the pivot. The partials and the watermarks are committed once the query
+	// runs, so they are kept even if the query fails later.
+	auto &args = materialization.args;
+	auto previous_high_watermarks = materialization.high_watermarks;
+	vector<string> table_filters;
+	unique_ptr<MaterializedQueryResult> input;
+	{
+		auto plan_cache = PivotTablePlanCache::Get(context);
+		lock_guard<mutex> guard(plan_cache->lock);
+		auto &con = plan_cache->GetConnection(context);
+		con.BeginTransaction();
+		try {
+			if (!stored) {
+				CheckOwnedTable(con, materialization.name);
+			}
+			table_filters = AppendedRowFilters(con, materialization);
+			PivotTableSQLBuilder builder(args);
+			if (stored) {
+				builder.FromPartials(materialization.name);
+			}
+			input = Run(con, builder.WithTableFilters(table_filters).NativeInput());
+			con.Commit();
+		} catch (std::exception &) {
+			con.Rollback();
+			throw;
+		}
+	}
+	auto on_execute = [materialization, previous_high_watermarks, table_filters, stored](ClientContext &context) {
+		StorePartials(context, materialization, previous_high_watermarks, table_filters, stored);
+	};
+	return PivotTableNativeFunction::BindInput(args, std::move(input), return_types, names, on_execute);
+}
+
+//===--------------------------------------------------------------------===//
+// pivot_table_materialize and pivot_table_refresh
+//===--------------------------------------------------------------------===//
+static string GetName(const string &function_name, const Value &name) {
+	if (name.IsNull() || StringValue::Get(name).empty()) {
+		throw InvalidInputException("%s: the name can not be NULL or empty", function_name);
+	}
+	return StringValue::Get(name);
+}
+
+static unique_ptr<FunctionData> PivotTableMaterializeBind(ClientContext &context, TableFunctionBindInput &input,
+                                                          vector<LogicalType> &return_types, vector<string> &names) {
+	PivotTableMaterialization materialization;
+	materialization.name = GetName("pivot_table_materialize", input.inputs[0]);
+	vector<Value> lists(input.inputs.begin() + 1, input.inputs.end());
+	materialization.args = PivotTableArguments::FromValues("pivot_table_materialize", lists, input.named_parameters);
+	for (auto &kv : input.named_parameters) {
+		if (StringUtil::Lower(kv.first) == "watermark" && !kv.second.IsNull()) {
+			materialization.watermark = StringValue::Get(kv.second);
+		}
+	}
+	auto &args = materialization.args;
+	// The stored partials are merged with the partials of the appended rows, so every value has to be mergeable.
+	// The pivot keys become the output columns, so there has to be at least one column.
+	if (args.columns.empty()) {
+		throw InvalidInputException("pivot_table_materialize: the columns parameter can not be empty");
+	}
+	if (!PivotTableSQLBuilder(args).MergeableValues()) {
+		throw InvalidInputException(
+		    "pivot_table_materialize: every value must be a single sum, count, min or max call (Ex: sum(amount))");
+	}
+	PivotTablePlanCache::CheckSnapshot(context, input, "pivot_table_materialize", args.table_names);
+	materialization.high_watermarks.resize(args.table_names.size(), Value(LogicalType::VARCHAR));
+	return Refresh(context, materialization, false, return_types, names);
+}
+
+static unique_ptr<FunctionData> PivotTableRefreshBind(ClientContext &context, TableFunctionBindInput &input,
+                                                      vector<LogicalType> &return_types, vector<string> &names) {
+	auto name = GetName("pivot_table_refresh", input.inputs[0]);
+	PivotTableMaterialization materialization;
+	{
+		auto plan_cache = PivotTablePlanCache::Get(context);
+		lock_guard<mutex> guard(plan_cache->lock);
+		auto &con = plan_cache->GetConnection(context);
+		materialization = LoadMetadata(con, name, input.named_parameters);
+	}
+	PivotTablePlanCache::CheckSnapshot(context, input, "pivot_table_refresh", materialization.args.table_names);
+	return Refresh(context, materialization, true, return_types, names);
+}
+
+TableFunction PivotTableMaterializeFunction::GetFunction() {
+	auto string_list = LogicalType::LIST(LogicalType::VARCHAR);
+	auto function = PivotTableNativeFunction::CreateFunction(
+	    "pivot_table_materialize",
+	    {LogicalType::VARCHAR, string_list, string_list, string_list, string_list, string_list},
+	    PivotTableMaterializeBind);
+	function.named_parameters["values_axis"] = LogicalType::VARCHAR;
+	function.named_parameters["subtotals"] = LogicalType::BOOLEAN;
+	function.named_parameters["grand_totals"] = LogicalType::BOOLEAN;
+	function.named_parameters["ordered"] = LogicalType::BOOLEAN;
+	function.named_parameters["max_rows"] = LogicalType::BIGINT;
+	function.named_parameters["watermark"] = LogicalType::VARCHAR;
+	return function;
+}
+
+TableFunction PivotTableMaterializeFunction::GetRefreshFunction() {
+	auto function =
+	    PivotTableNativeFunction::CreateFunction("pivot_table_refresh", {LogicalType::VARCHAR}, PivotTableRefreshBind);
+	function.named_parameters["ordered"] = LogicalType::BOOLEAN;
+	function.named_parameters["max_rows"] = LogicalType::BIGINT;
+	return function;
+}
+
+} // namespace duckdb
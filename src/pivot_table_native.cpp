@@ -0,0 +1,1069 @@
+#include "pivot_table_native.hpp"
+#include "pivot_table_cache.hpp"
+#include "pivot_table_sql.hpp"
+
+#include "duckdb/catalog/catalog.hpp"
+#include "duckdb/catalog/catalog_entry/table_catalog_entry.hpp"
+#include "duckdb/common/case_insensitive_map.hpp"
+#include "duckdb/common/exception.hpp"
+#include "duckdb/common/limits.hpp"
+#include "duckdb/common/numeric_utils.hpp"
+#include "duckdb/common/types/column/column_data_collection.hpp"
+#include "duckdb/common/vector_operations/vector_operations.hpp"
+#include "duckdb/function/table_function.hpp"
+#include "duckdb/main/connection.hpp"
+#include "duckdb/main/materialized_query_result.hpp"
+#include "duckdb/parser/expression/columnref_expression.hpp"
+#include "duckdb/parser/parsed_expression_iterator.hpp"
+#include "duckdb/parser/parser.hpp"
+#include "duckdb/parser/qualified_name.hpp"
+#include "duckdb/parser/statement/select_statement.hpp"
+#include "duckdb/parser/tableref/subqueryref.hpp"
+#include "duckdb/storage/statistics/base_statistics.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace duckdb {
+
+//===--------------------------------------------------------------------===//
+// Arguments
+//===--------------------------------------------------------------------===//
+//! Add the names of the columns that an expression refers to (only unqualified references).
+//! Lambda parameters look like column references, so lambdas are not searched.
+//! Returns false if the expression refers to columns that are not named (Ex: COLUMNS(*)).
+static bool CollectColumnNames(const ParsedExpression &expr, vector<string> &names) {
+	if (expr.GetExpressionClass() == ExpressionClass::LAMBDA) {
+		return true;
+	}
+	if (expr.GetExpressionClass() == ExpressionClass::STAR) {
+		return false;
+	}
+	if (expr.GetExpressionClass() == ExpressionClass::COLUMN_REF) {
+		auto &colref = expr.Cast<ColumnRefExpression>();
+		if (!colref.IsQualified()) {
+			names.push_back(colref.GetColumnName());
+		}
+		return true;
+	}
+	bool complete = true;
+	ParsedExpressionIterator::EnumerateChildren(expr, [&](const ParsedExpression &child) {
+		complete = CollectColumnNames(child, names) && complete;
+	});
+	return complete;
+}
+
+bool PivotTableReferencedColumns(const PivotTableArguments &args, vector<string> &names) {
+	names.insert(names.end(), args.rows.begin(), args.rows.end());
+	names.insert(names.end(), args.columns.begin(), args.columns.end());
+	vector<string> expressions = args.values;
+	expressions.insert(expressions.end(), args.filters.begin(), args.filters.end());
+	if (!args.rank_by.empty()) {
+		expressions.push_back(args.rank_by);
+	}
+	bool complete = true;
+	for (auto &expression : expressions) {
+		try {
+			for (auto &parsed : Parser::ParseExpressionList(expression)) {
+				complete = CollectColumnNames(*parsed, names) && complete;
+			}
+		} catch (std::exception &) {
+			// The generated SQL will report the error
+			complete = false;
+		}
+	}
+	return complete;
+}
+
+vector<string> PivotTableScannedColumns(Connection &con, const vector<string> &table_names,
+                                        const vector<string> &referenced) {
+	case_insensitive_set_t referenced_names(referenced.begin(), referenced.end());
+	auto every_column = con.Query("FROM (" + PivotTableSQLBuilder::BatchScan(table_names, {}, {}) + ") LIMIT 0");
+	if (every_column->HasError()) {
+		every_column->ThrowError();
+	}
+	vector<string> columns;
+	for (auto &name : every_column->names) {
+		if (referenced_names.count(name)) {
+			columns.push_back(name);
+		}
+	}
+	if (columns.empty() && !every_column->names.empty()) {
+		columns.push_back(every_column->names[0]);
+	}
+	return columns;
+}
+
+//! With several tables (Ex: one partition per month), skip the tables that lack a column that the pivot refers to,
+//! instead of failing to combine them. Tables that can not be looked up (Ex: views) are always kept.
+//! Tables whose statistics exclude the filters are not skipped here: the filters are pushed into each table scan,
+//! which then skips every row group (or Parquet file) that the statistics exclude.
+static void SkipTablesWithoutColumns(ClientContext &context, PivotTableArguments &args) {
+	if (args.table_names.size() < 2) {
+		return;
+	}
+	vector<string> referenced;
+	PivotTableReferencedColumns(args, referenced);
+	vector<string> kept;
+	for (auto &table_name : args.table_names) {
+		bool has_columns = true;
+		try {
+			auto name = QualifiedName::Parse(table_name);
+			auto table = Catalog::GetEntry<TableCatalogEntry>(context, name.catalog, name.schema, name.name,
+			                                                  OnEntryNotFound::RETURN_NULL);
+			for (idx_t i = 0; table && i < referenced.size() && has_columns; i++) {
+				has_columns = table->ColumnExists(referenced[i]);
+			}
+		} catch (std::exception &) {
+			has_columns = true;
+		}
+		if (has_columns) {
+			kept.push_back(table_name);
+		}
+	}
+	// If no table has every column, keep them all so that the error names the missing column
+	if (!kept.empty()) {
+		args.table_names = std::move(kept);
+	}
+}
+
+static PivotTableArguments ParseArguments(ClientContext &context, TableFunctionBindInput &input) {
+	auto result = PivotTableArguments::FromValues("pivot_table_native", input.inputs, input.named_parameters);
+	SkipTablesWithoutColumns(context, result);
+	return result;
+}
+
+//===--------------------------------------------------------------------===//
+// Pivot key guard
+//===--------------------------------------------------------------------===//
+static void ThrowTooManyPivotKeys(const string &key_count, idx_t max_pivot_keys) {
+	throw InvalidInputException("pivot_table_native: the columns parameter has %s distinct values, more than "
+	                            "max_pivot_keys (%llu). Pass overflow := 'other' to keep the top pivot keys and "
+	                            "collapse the rest, or overflow := 'long' to return a row per pivot key",
+	                            key_count, max_pivot_keys);
+}
+
+//! The distinct count in the statistics of a column is an estimate (a HyperLogLog sketch, which is not lowered by
+//! deletes or updates), so the statistics only decide when they are this many times above max_pivot_keys
+static constexpr idx_t PIVOT_KEYS_STATISTICS_MARGIN = 2;
+
+//! Every value (or NULL) of each column is in at least one pivot key, so the largest distinct count in the statistics
+//! of a column estimates the least number of pivot keys (the number of combinations can be much smaller than their
+//! product). Returns an invalid index if the statistics do not apply: with filters or a sample (the statistics are of
+//! every row), or if a table has no statistics (Ex: a view or a Parquet file).
+static optional_idx PivotKeysStatisticsEstimate(ClientContext &context, const PivotTableArguments &args) {
+	if (!args.filters.empty() || args.Sampled()) {
+		return optional_idx();
+	}
+	idx_t result = 0;
+	for (auto &table_name : args.table_names) {
+		optional_ptr<TableCatalogEntry> table;
+		try {
+			auto name = QualifiedName::Parse(table_name);
+			table = Catalog::GetEntry<TableCatalogEntry>(context, name.catalog, name.schema, name.name,
+			                                             OnEntryNotFound::RETURN_NULL);
+		} catch (std::exception &) {
+			table = nullptr;
+		}
+		if (!table) {
+			return optional_idx();
+		}
+		for (const auto &column_name : args.columns) {
+			if (!table->ColumnExists(column_name)) {
+				return optional_idx();
+			}
+			auto stats = table->GetStatistics(context, table->GetColumnIndex(column_name).index);
+			// A distinct count of zero means that it is unknown
+			if (!stats || stats->GetDistinctCount() == 0) {
+				return optional_idx();
+			}
+			result = MaxValue<idx_t>(result, stats->GetDistinctCount() + (stats->CanHaveNull() ? 1 : 0));
+		}
+	}
+	return optional_idx(result);
+}
+
+//! Fail before aggregating if there are more than max_pivot_keys pivot keys. The statistics of the tables fail fast
+//! when they are clearly above max_pivot_keys, otherwise the keys are counted approximately with a HyperLogLog sketch
+//! (which only reads the columns and the filters). The exact number of keys is checked again after aggregating.
+static void CheckPivotKeys(ClientContext &context, const PivotTableArguments &args, PivotTablePlanCache &plan_cache) {
+	auto statistics_estimate = PivotKeysStatisticsEstimate(context, args);
+	if (statistics_estimate.IsValid() &&
+	    statistics_estimate.GetIndex() / PIVOT_KEYS_STATISTICS_MARGIN > args.max_pivot_keys.GetIndex()) {
+		ThrowTooManyPivotKeys("about " + to_string(statistics_estimate.GetIndex()), args.max_pivot_keys.GetIndex());
+	}
+	auto sql = PivotTableSQLBuilder(args).CombineByName().EstimatePivotKeys();
+	unique_ptr<MaterializedQueryResult> result;
+	{
+		lock_guard<mutex> guard(plan_cache.lock);
+		result = plan_cache.GetConnection(context).Query(sql);
+	}
+	if (result->HasError()) {
+		// The aggregation reports the error
+		return;
+	}
+	auto estimate = NumericCast<idx_t>(result->GetValue(0, 0).GetValue<int64_t>());
+	if (estimate > args.max_pivot_keys.GetIndex()) {
+		ThrowTooManyPivotKeys("about " + to_string(estimate), args.max_pivot_keys.GetIndex());
+	}
+}
+
+//===--------------------------------------------------------------------===//
+// Partitions
+//===--------------------------------------------------------------------===//
+string PivotTableNativeFunction::WritePartitions(Connection &con, const string &function_name,
+                                                 const PivotTableArguments &args,
+                                                 const std::function<void()> &on_statement) {
+	if (!PivotTableSQLBuilder(args).SimpleValues()) {
+		throw InvalidInputException("%s: with partitions, every value must be a single sum, count, min, max or avg "
+		                            "call (Ex: sum(amount))",
+		                            function_name);
+	}
+	if (args.CollapseKeys()) {
+		throw InvalidInputException("%s: partitions can not be combined with overflow := 'other'", function_name);
+	}
+	// The tables are scanned once: the rows that match the filters are copied with only the columns that the pivot
+	// refers to, and sorted by the partition of their detail group (see PartitionScan). Each partition is then its own
+	// statement, so only its groups are in the aggregate's hash table, and it only reads its own row groups of the
+	// copy. The copy, and the partials that each partition appends to the temporary table (along with the totals of
+	// its own detail groups), are written out to temporary files when they exceed the memory limit.
+	vector<string> referenced;
+	vector<string> columns;
+	if (PivotTableReferencedColumns(args, referenced)) {
+		columns = PivotTableScannedColumns(con, args.table_names, referenced);
+	}
+	vector<string> statements {"CREATE OR REPLACE TEMP TABLE " + string(PARTITION_SCAN_TABLE) + " AS\n" +
+	                           PivotTableSQLBuilder(args).CombineByName().PartitionScan(columns)};
+	for (idx_t partition = 0; partition < args.partitions; partition++) {
+		auto sql = PivotTableSQLBuilder(args).FromPartitionScan(PARTITION_SCAN_TABLE).PartitionPartials(partition);
+		statements.push_back((partition == 0 ? "CREATE OR REPLACE TEMP TABLE " : "INSERT INTO ") +
+		                     string(PARTITIONS_TABLE) + (partition == 0 ? " AS\n" : "\n") + sql);
+	}
+	for (auto &statement : statements) {
+		auto result = con.Query(statement);
+		if (result->HasError()) {
+			DropPartitions(con);
+			result->ThrowError();
+		}
+		if (on_statement) {
+			on_statement();
+		}
+	}
+	con.Query("DROP TABLE IF EXISTS " + string(PARTITION_SCAN_TABLE));
+	// The detail groups are only finalized, and only the totals of the partitions are merged (see FromPartitions)
+	return PivotTableSQLBuilder(args).CombineByName().FromPartitions(PARTITIONS_TABLE).NativeInput();
+}
+
+void PivotTableNativeFunction::DropPartitions(Connection &con) {
+	con.Query("DROP TABLE IF EXISTS " + string(PARTITION_SCAN_TABLE));
+	con.Query("DROP TABLE IF EXISTS " + string(PARTITIONS_TABLE));
+}
+
+static unique_ptr<TableRef> ParseSubquery(ClientContext &context, const string &query) {
+	Parser parser(context.GetParserOptions());
+	parser.ParseQuery(query);
+	if (parser.statements.size() != 1 || parser.statements[0]->type != StatementType::SELECT_STATEMENT) {
+		throw ParserException("pivot_table_native: expected a single SELECT statement");
+	}
+	auto select_stmt = unique_ptr_cast<SQLStatement, SelectStatement>(std::move(parser.statements[0]));
+	return make_uniq<SubqueryRef>(std::move(select_stmt));
+}
+
+//===--------------------------------------------------------------------===//
+// Bind
+//===--------------------------------------------------------------------===//
+struct PivotTableNativeBindData : public TableFunctionData {
+	//! The aggregated data in long format, sorted by the group columns (see PivotTableSQLBuilder::NativeInput)
+	unique_ptr<MaterializedQueryResult> input;
+	//! The number of columns that identify an output row (the rows parameter, and value_names if values are on rows)
+	idx_t group_count;
+	//! The number of output columns per pivot key
+	idx_t value_count;
+	//! The number of values that are laid out key by key. With a sample_fraction, the last value (sample_rows) is not:
+	//! its columns come after every other value's, so that the exact layout comes first.
+	idx_t exact_value_count;
+	//! The number of distinct pivot keys
+	idx_t key_count = 0;
+	//! For each input row, the position of its pivot key in the sorted pivot keys, or DConstants::INVALID_INDEX if the
+	//! row is not part of any pivoted column
+	vector<idx_t> row_offsets;
+	//! Whether the input is sorted by the group columns (otherwise the output rows are grouped in a hash table)
+	bool ordered;
+	//! The maximum number of output rows, if any
+	optional_idx max_rows;
+	//! Whether there are more pivot keys than max_pivot_keys, so the input is returned in long format (a row per
+	//! pivot key) instead of being pivoted
+	bool long_format = false;
+	//! Run when the query runs (see BindInput)
+	std::function<void(ClientContext &)> on_execute;
+
+	idx_t KeyIndex() const {
+		// The input starts with the dummy_column, followed by the group columns and the pivot key
+		return 1 + group_count;
+	}
+	idx_t ValueIndex(idx_t value) const {
+		return KeyIndex() + 1 + value;
+	}
+	idx_t EmptyValueIndex(idx_t value) const {
+		return KeyIndex() + 1 + value_count + value;
+	}
+	//! The output column of a value for the first pivot key, and the number of columns to the next pivot key
+	idx_t ValueColumn(idx_t value) const {
+		if (value < exact_value_count) {
+			return group_count + value;
+		}
+		return group_count + key_count * exact_value_count + value - exact_value_count;
+	}
+	idx_t ValueStride(idx_t value) const {
+		return value < exact_value_count ? exact_value_count : value_count - exact_value_count;
+	}
+};
+
+static unique_ptr<TableRef> PivotTableNativeBindReplace(ClientContext &context, TableFunctionBindInput &input) {
+	auto args = ParseArguments(context, input);
+	if (!args.columns.empty()) {
+		// There are pivot keys to discover, use the regular bind
+		return nullptr;
+	}
+	// Without columns there is nothing to pivot: pivot_table is already a single GROUP BY and needs no enum
+	auto sql = PivotTableSQLBuilder(args).CombineByName().PivotTable();
+	return ParseSubquery(context, "FROM (" + sql + ") SELECT * EXCLUDE (dummy_column)");
+}
+
+static unique_ptr<FunctionData> PivotTableNativeBind(ClientContext &context, TableFunctionBindInput &input,
+                                                     vector<LogicalType> &return_types, vector<string> &names) {
+	auto args = ParseArguments(context, input);
+	PivotTablePlanCache::CheckSnapshot(context, input, "pivot_table_native", args.table_names);
+	// max_rows is applied while scanning, so pivots that only differ in max_rows share a cached plan
+	auto max_rows = args.max_rows;
+	args.max_rows = optional_idx();
+
+	// The output columns depend on which pivot keys exist in the data, so the aggregation has to run while binding.
+	// Pivots that only differ in their filter literals share a cached plan (see pivot_table_cache.hpp).
+	auto plan_cache = PivotTablePlanCache::Get(context);
+	if (args.max_pivot_keys.IsValid() && args.overflow == "error") {
+		CheckPivotKeys(context, args, *plan_cache);
+	}
+	if (args.partitions > 1) {
+		unique_ptr<MaterializedQueryResult> result;
+		{
+			lock_guard<mutex> guard(plan_cache->lock);
+			auto &con = plan_cache->GetConnection(context);
+			auto sql = PivotTableNativeFunction::WritePartitions(con, "pivot_table_native", args);
+			result = con.Query(sql);
+			PivotTableNativeFunction::DropPartitions(con);
+		}
+		if (result->HasError()) {
+			result->ThrowError();
+		}
+		args.max_rows = max_rows;
+		return PivotTableNativeFunction::BindInput(args, std::move(result), return_types, names);
+	}
+	vector<Value> parameters;
+	auto parameterized = args;
+	parameterized.filters = PivotTableParameterizeFilters(args.filters, parameters);
+	auto result = plan_cache->Execute(context, parameterized, parameters);
+	if (result->HasError() && !parameters.empty() && PivotTableIsBindError(result->GetErrorObject())) {
+		// Some literals can not be parameters (Ex: they must be constant while binding), so plan with the literals
+		parameters.clear();
+		result = plan_cache->Execute(context, args, parameters);
+	}
+	if (result->HasError() && args.aggregate_in_parts && PivotTableIsBindError(result->GetErrorObject())) {
+		// A simple value can fail to bind when it is aggregated in parts (Ex: an avg of timestamps has no sum), so
+		// aggregate it directly (this also reports the error if there is one)
+		args.aggregate_in_parts = false;
+		result = plan_cache->Execute(context, args, parameters);
+	}
+	if (result->HasError()) {
+		result->ThrowError();
+	}
+	args.max_rows = max_rows;
+	return PivotTableNativeFunction::BindInput(args, std::move(result), return_types, names);
+}
+
+unique_ptr<FunctionData> PivotTableNativeFunction::BindInput(const PivotTableArguments &args,
+                                                             unique_ptr<MaterializedQueryResult> input,
+                                                             vector<LogicalType> &return_types, vector<string> &names,
+                                                             std::function<void(ClientContext &)> on_execute) {
+	auto result = make_uniq<PivotTableNativeBindData>();
+	result->input = std::move(input);
+	result->on_execute = std::move(on_execute);
+	result->group_count = args.rows.size() + (args.ValuesOnRows() ? 1 : 0);
+	result->value_count = args.ValuesOnRows() ? 1 : MaxValue<idx_t>(args.values.size(), 1);
+	// With values on rows, the sample_rows row comes after the rows of the other values (see AppendTotalsOutput)
+	result->exact_value_count = args.Sampled() && !args.ValuesOnRows() ? result->value_count - 1 : result->value_count;
+	result->ordered = args.ordered;
+	result->max_rows = args.max_rows;
+	auto &input_types = result->input->types;
+	auto &input_names = result->input->names;
+	if (input_types.size() != result->EmptyValueIndex(result->value_count) ||
+	    input_types[result->KeyIndex()].id() != LogicalTypeId::VARCHAR) {
+		throw InternalException("pivot_table_native: unexpected result shape from the generated SQL");
+	}
+	// The empty values are copied into the same columns as the values
+	for (idx_t v = 0; v < result->value_count; v++) {
+		if (input_types[result->ValueIndex(v)] != input_types[result->EmptyValueIndex(v)]) {
+			throw InternalException("pivot_table_native: the empty values do not have the type of the values");
+		}
+	}
+
+	// Discover the distinct pivot keys, numbered in the order in which they are first seen, and the key of every row.
+	// A NULL key means that this row is not part of any pivoted column.
+	unordered_map<string, idx_t> key_ids;
+	vector<string> keys;
+	result->row_offsets.reserve(result->input->RowCount());
+	for (auto &chunk : result->input->Collection().Chunks()) {
+		UnifiedVectorFormat key_data;
+		chunk.data[result->KeyIndex()].ToUnifiedFormat(chunk.size(), key_data);
+		auto key_values = UnifiedVectorFormat::GetData<string_t>(key_data);
+		for (idx_t row = 0; row < chunk.size(); row++) {
+			auto idx = key_data.sel->get_index(row);
+			if (!key_data.validity.RowIsValid(idx)) {
+				result->row_offsets.push_back(DConstants::INVALID_INDEX);
+				continue;
+			}
+			auto entry = key_ids.emplace(key_values[idx].GetString(), keys.size());
+			if (entry.second) {
+				keys.push_back(entry.first->first);
+			}
+			result->row_offsets.push_back(entry.first->second);
+		}
+	}
+
+	for (idx_t i = 0; i < result->group_count; i++) {
+		return_types.push_back(input_types[1 + i]);
+		names.push_back(input_names[1 + i]);
+	}
+	if (args.max_pivot_keys.IsValid() && keys.size() > args.max_pivot_keys.GetIndex()) {
+		if (args.overflow != "long") {
+			ThrowTooManyPivotKeys(to_string(keys.size()), args.max_pivot_keys.GetIndex());
+		}
+		// The memory of the output grows with the number of rows and pivot keys that exist in the data,
+		// instead of with the number of rows times the number of pivot keys
+		result->long_format = true;
+		return_types.push_back(LogicalType::VARCHAR);
+		names.push_back("pivot_key");
+		for (idx_t v = 0; v < result->value_count; v++) {
+			return_types.push_back(input_types[result->ValueIndex(v)]);
+			names.push_back(args.ValuesOnRows() ? "value" : args.values.empty() ? "count(*)" : args.values[v]);
+		}
+		return std::move(result);
+	}
+	// Keys are laid out in sorted order, like the ORDER BY in build_my_enum.
+	// With multiple values on columns, each value gets a column per key named like PIVOT does (key_value).
+	vector<idx_t> sorted_ids(keys.size());
+	for (idx_t id = 0; id < keys.size(); id++) {
+		sorted_ids[id] = id;
+	}
+	std::sort(sorted_ids.begin(), sorted_ids.end(), [&](idx_t a, idx_t b) { return keys[a] < keys[b]; });
+	vector<idx_t> key_positions(keys.size());
+	for (idx_t position = 0; position < sorted_ids.size(); position++) {
+		key_positions[sorted_ids[position]] = position;
+	}
+	result->key_count = keys.size();
+	return_types.resize(result->group_count + result->key_count * result->value_count);
+	names.resize(return_types.size());
+	for (idx_t v = 0; v < result->value_count; v++) {
+		for (idx_t position = 0; position < sorted_ids.size(); position++) {
+			auto &key = keys[sorted_ids[position]];
+			auto column = result->ValueColumn(v) + position * result->ValueStride(v);
+			return_types[column] = input_types[result->ValueIndex(v)];
+			names[column] = args.ValuesOnRows() || args.values.size() <= 1 ? key : key + "_" + args.values[v];
+		}
+	}
+	for (auto &row_offset : result->row_offsets) {
+		if (row_offset != DConstants::INVALID_INDEX) {
+			row_offset = key_positions[row_offset];
+		}
+	}
+	if (return_types.empty()) {
+		throw InvalidInputException("pivot_table_native: no pivot keys were found in the data and the rows parameter is "
+		                            "empty, so there are no columns to return");
+	}
+	return std::move(result);
+}
+
+//===--------------------------------------------------------------------===//
+// Scan
+//===--------------------------------------------------------------------===//
+//! The cells to copy from an input column into the output: the input row, the output row and the offset of the
+//! output column of each cell (in strides, see CopyCells)
+struct PivotTableCells {
+	idx_t count = 0;
+	vector<idx_t> input_rows;
+	vector<idx_t> output_rows;
+	vector<idx_t> offsets;
+
+	void Add(idx_t input_row, idx_t output_row, idx_t offset) {
+		input_rows.push_back(input_row);
+		output_rows.push_back(output_row);
+		offsets.push_back(offset);
+		count++;
+	}
+	void Clear() {
+		input_rows.clear();
+		output_rows.clear();
+		offsets.clear();
+		count = 0;
+	}
+};
+
+struct PivotTableNativeState : public GlobalTableFunctionState {
+	ColumnDataScanState scan_state;
+	DataChunk input_chunk;
+	//! The next row of input_chunk to lay out
+	idx_t input_offset = 0;
+	//! The index of the first row of input_chunk in the whole input
+	idx_t input_start = 0;
+	bool finished = false;
+	//! The number of output rows returned so far
+	idx_t emitted = 0;
+	//! The output rows that start in the input chunk, and the pivoted cells that it fills in
+	PivotTableCells started;
+	PivotTableCells cells;
+
+	//! Without ordering, the output row of every input row and the last input chunk with a row of each output chunk
+	//! (see GroupUnorderedInput)
+	vector<idx_t> output_rows;
+	vector<idx_t> last_input_chunks;
+	vector<LogicalType> output_types;
+	//! Without ordering, the output chunks that are being laid out, the cells that the input chunk fills in per output
+	//! chunk, and the output chunks that it touched (see LayOutUnorderedInput)
+	vector<unique_ptr<DataChunk>> output_chunks;
+	vector<PivotTableCells> started_per_chunk;
+	vector<PivotTableCells> cells_per_chunk;
+	vector<idx_t> touched_chunks;
+	//! Without ordering, the index of input_chunk, and the number of output rows started so far
+	idx_t input_index = 0;
+	idx_t started_rows = 0;
+	//! Without ordering, the output chunks in the order in which they are complete, the next one to return, and the one
+	//! that was returned last
+	vector<idx_t> completed_chunks;
+	idx_t next_completed = 0;
+	unique_ptr<DataChunk> returned;
+};
+
+template <class T>
+static T CopyCell(Vector &, const T &value) {
+	return value;
+}
+
+template <>
+string_t CopyCell(Vector &target, const string_t &value) {
+	return StringVector::AddStringOrBlob(target, value);
+}
+
+template <class T>
+static void TemplatedCopyCells(UnifiedVectorFormat &input_data, DataChunk &output, idx_t column,
+                               const PivotTableCells &cells, idx_t repeat, idx_t stride) {
+	auto input_values = UnifiedVectorFormat::GetData<T>(input_data);
+	for (idx_t r = 0; r < repeat; r++) {
+		for (idx_t i = 0; i < cells.count; i++) {
+			auto &target = output.data[column + (r + cells.offsets[i]) * stride];
+			auto idx = input_data.sel->get_index(cells.input_rows[i]);
+			auto output_row = cells.output_rows[i];
+			if (!input_data.validity.RowIsValid(idx)) {
+				FlatVector::SetNull(target, output_row, true);
+				continue;
+			}
+			FlatVector::GetData<T>(target)[output_row] = CopyCell<T>(target, input_values[idx]);
+			FlatVector::Validity(target).SetValid(output_row);
+		}
+	}
+}
+
+//! Copy the cells of an input column into the output columns that start at column, a vector at a time. A cell goes
+//! offset strides past column, and is copied repeat times, a stride apart (Ex: an empty value into the cell of every
+//! pivot key).
+static void CopyCells(Vector &input, idx_t input_size, DataChunk &output, idx_t column, const PivotTableCells &cells,
+                      idx_t stride = 1, idx_t repeat = 1) {
+	if (cells.count == 0) {
+		return;
+	}
+	UnifiedVectorFormat input_data;
+	input.ToUnifiedFormat(input_size, input_data);
+	switch (input.GetType().InternalType()) {
+	case PhysicalType::BOOL:
+		TemplatedCopyCells<bool>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::INT8:
+		TemplatedCopyCells<int8_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::INT16:
+		TemplatedCopyCells<int16_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::INT32:
+		TemplatedCopyCells<int32_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::INT64:
+		TemplatedCopyCells<int64_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::INT128:
+		TemplatedCopyCells<hugeint_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::UINT8:
+		TemplatedCopyCells<uint8_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::UINT16:
+		TemplatedCopyCells<uint16_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::UINT32:
+		TemplatedCopyCells<uint32_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::UINT64:
+		TemplatedCopyCells<uint64_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::UINT128:
+		TemplatedCopyCells<uhugeint_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::FLOAT:
+		TemplatedCopyCells<float>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::DOUBLE:
+		TemplatedCopyCells<double>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::INTERVAL:
+		TemplatedCopyCells<interval_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	case PhysicalType::VARCHAR:
+		TemplatedCopyCells<string_t>(input_data, output, column, cells, repeat, stride);
+		break;
+	default:
+		// Nested values (Ex: a list or a struct) are copied one at a time
+		for (idx_t r = 0; r < repeat; r++) {
+			for (idx_t i = 0; i < cells.count; i++) {
+				output.data[column + (r + cells.offsets[i]) * stride].SetValue(cells.output_rows[i],
+				                                                                input.GetValue(cells.input_rows[i]));
+			}
+		}
+		break;
+	}
+}
+
+//! Start the new output rows: their group columns, and the result of each value over zero rows in the cell of every
+//! pivot key (Ex: 0 for count(*)), which the cells with data then overwrite
+static void CopyRows(const PivotTableNativeBindData &bind_data, DataChunk &input, DataChunk &output,
+                     const PivotTableCells &started, const PivotTableCells &cells) {
+	auto size = input.size();
+	for (idx_t i = 0; i < bind_data.group_count; i++) {
+		CopyCells(input.data[1 + i], size, output, i, started);
+	}
+	for (idx_t v = 0; v < bind_data.value_count; v++) {
+		CopyCells(input.data[bind_data.EmptyValueIndex(v)], size, output, bind_data.ValueColumn(v), started,
+		          bind_data.ValueStride(v), bind_data.key_count);
+	}
+	for (idx_t v = 0; v < bind_data.value_count; v++) {
+		CopyCells(input.data[bind_data.ValueIndex(v)], size, output, bind_data.ValueColumn(v), cells,
+		          bind_data.ValueStride(v));
+	}
+}
+
+static bool SameGroup(const PivotTableNativeBindData &bind_data, DataChunk &input, idx_t row, DataChunk &output,
+                      idx_t output_row) {
+	for (idx_t i = 0; i < bind_data.group_count; i++) {
+		if (!Value::NotDistinctFrom(input.GetValue(1 + i, row), output.data[i].GetValue(output_row))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//! Lay out the input chunk from input_offset on into the output, which already has count rows. The input is sorted by
+//! the group columns, so a new output row starts whenever one of them changes. Returns false (leaving input_offset at
+//! the row that starts it) if a new output row has to start once the output has capacity rows, so that every output
+//! row is complete when it is returned.
+static bool LayOutInput(const PivotTableNativeBindData &bind_data, PivotTableNativeState &state, DataChunk &output,
+                        idx_t &count, idx_t capacity) {
+	auto &input = state.input_chunk;
+	auto offset = state.input_offset;
+	auto size = input.size();
+
+	// Compare the group of each row with the group of the row before it, a column at a time. The first row continues
+	// the last output row if it has the same group (the group can span input chunks).
+	bool starts_row[STANDARD_VECTOR_SIZE];
+	starts_row[offset] = count == 0 || !SameGroup(bind_data, input, offset, output, count - 1);
+	for (idx_t row = offset + 1; row < size; row++) {
+		starts_row[row] = false;
+	}
+	if (size - offset > 1) {
+		auto compare_count = size - offset - 1;
+		SelectionVector current_sel(compare_count);
+		SelectionVector previous_sel(compare_count);
+		SelectionVector distinct_sel(compare_count);
+		for (idx_t i = 0; i < compare_count; i++) {
+			current_sel.set_index(i, offset + 1 + i);
+			previous_sel.set_index(i, offset + i);
+		}
+		for (idx_t i = 0; i < bind_data.group_count; i++) {
+			Vector current(input.data[1 + i], current_sel, compare_count);
+			Vector previous(input.data[1 + i], previous_sel, compare_count);
+			auto distinct_count =
+			    VectorOperations::DistinctFrom(current, previous, nullptr, compare_count, &distinct_sel, nullptr);
+			for (idx_t d = 0; d < distinct_count; d++) {
+				starts_row[offset + 1 + distinct_sel.get_index(d)] = true;
+			}
+		}
+	}
+
+	// Find the output row and the output columns of every input row
+	state.started.Clear();
+	state.cells.Clear();
+	bool full = false;
+	auto row = offset;
+	for (; row < size; row++) {
+		if (starts_row[row]) {
+			if (count == capacity) {
+				full = true;
+				break;
+			}
+			state.started.Add(row, count++, 0);
+		}
+		auto row_offset = bind_data.row_offsets[state.input_start + row];
+		if (row_offset != DConstants::INVALID_INDEX) {
+			state.cells.Add(row, count - 1, row_offset);
+		}
+	}
+	state.input_offset = row;
+	CopyRows(bind_data, input, output, state.started, state.cells);
+	return !full;
+}
+
+//! Append the bytes of each value to the group key of its row. Groups are keys of a hash table, so values that GROUP BY
+//! considers the same (Ex: 0.0 and -0.0) get the same bytes.
+template <class T>
+static void AppendKeyBytes(string &key, const T &value) {
+	key.append(const_char_ptr_cast(&value), sizeof(T));
+}
+
+template <>
+void AppendKeyBytes(string &key, const string_t &value) {
+	auto size = NumericCast<uint32_t>(value.GetSize());
+	key.append(const_char_ptr_cast(&size), sizeof(size));
+	key.append(value.GetData(), value.GetSize());
+}
+
+template <class T>
+static void AppendFloatKeyBytes(string &key, T value) {
+	if (value == 0) {
+		value = 0;
+	} else if (Value::IsNan(value)) {
+		value = std::numeric_limits<T>::quiet_NaN();
+	}
+	key.append(const_char_ptr_cast(&value), sizeof(T));
+}
+
+template <>
+void AppendKeyBytes(string &key, const float &value) {
+	AppendFloatKeyBytes<float>(key, value);
+}
+
+template <>
+void AppendKeyBytes(string &key, const double &value) {
+	AppendFloatKeyBytes<double>(key, value);
+}
+
+template <class T>
+static void TemplatedAppendGroupKeys(UnifiedVectorFormat &input_data, idx_t count, vector<string> &keys) {
+	auto input_values = UnifiedVectorFormat::GetData<T>(input_data);
+	for (idx_t row = 0; row < count; row++) {
+		auto idx = input_data.sel->get_index(row);
+		if (!input_data.validity.RowIsValid(idx)) {
+			keys[row] += 'N';
+			continue;
+		}
+		keys[row] += 'V';
+		AppendKeyBytes<T>(keys[row], input_values[idx]);
+	}
+}
+
+//! Append a group column to the group key of each row, a vector at a time
+static void AppendGroupKeys(Vector &input, idx_t count, vector<string> &keys) {
+	UnifiedVectorFormat input_data;
+	input.ToUnifiedFormat(count, input_data);
+	switch (input.GetType().InternalType()) {
+	case PhysicalType::BOOL:
+		TemplatedAppendGroupKeys<bool>(input_data, count, keys);
+		break;
+	case PhysicalType::INT8:
+		TemplatedAppendGroupKeys<int8_t>(input_data, count, keys);
+		break;
+	case PhysicalType::INT16:
+		TemplatedAppendGroupKeys<int16_t>(input_data, count, keys);
+		break;
+	case PhysicalType::INT32:
+		TemplatedAppendGroupKeys<int32_t>(input_data, count, keys);
+		break;
+	case PhysicalType::INT64:
+		TemplatedAppendGroupKeys<int64_t>(input_data, count, keys);
+		break;
+	case PhysicalType::INT128:
+		TemplatedAppendGroupKeys<hugeint_t>(input_data, count, keys);
+		break;
+	case PhysicalType::UINT8:
+		TemplatedAppendGroupKeys<uint8_t>(input_data, count, keys);
+		break;
+	case PhysicalType::UINT16:
+		TemplatedAppendGroupKeys<uint16_t>(input_data, count, keys);
+		break;
+	case PhysicalType::UINT32:
+		TemplatedAppendGroupKeys<uint32_t>(input_data, count, keys);
+		break;
+	case PhysicalType::UINT64:
+		TemplatedAppendGroupKeys<uint64_t>(input_data, count, keys);
+		break;
+	case PhysicalType::UINT128:
+		TemplatedAppendGroupKeys<uhugeint_t>(input_data, count, keys);
+		break;
+	case PhysicalType::FLOAT:
+		TemplatedAppendGroupKeys<float>(input_data, count, keys);
+		break;
+	case PhysicalType::DOUBLE:
+		TemplatedAppendGroupKeys<double>(input_data, count, keys);
+		break;
+	case PhysicalType::INTERVAL:
+		TemplatedAppendGroupKeys<interval_t>(input_data, count, keys);
+		break;
+	case PhysicalType::VARCHAR:
+		TemplatedAppendGroupKeys<string_t>(input_data, count, keys);
+		break;
+	default:
+		// Nested values (Ex: a list or a struct) are appended as their text, one at a time
+		for (idx_t row = 0; row < count; row++) {
+			auto value = input.GetValue(row);
+			if (value.IsNull()) {
+				keys[row] += 'N';
+				continue;
+			}
+			auto text = value.ToString();
+			keys[row] += 'V' + to_string(text.size()) + ":" + text;
+		}
+		break;
+	}
+}
+
+//! Without ordering the input is not sorted by the group columns, so the output row of each input row is looked up by
+//! its group once, before the first row is returned. The output rows are numbered in the order in which their group
+//! first appears in the input, and the last input chunk that has a row of each output chunk is kept, so that each
+//! output chunk can be returned as soon as that input chunk is laid out (see LayOutUnorderedInput).
+static void GroupUnorderedInput(const PivotTableNativeBindData &bind_data, PivotTableNativeState &state) {
+	auto &input_types = bind_data.input->types;
+	state.output_types.resize(bind_data.group_count + bind_data.key_count * bind_data.value_count);
+	for (idx_t i = 0; i < bind_data.group_count; i++) {
+		state.output_types[i] = input_types[1 + i];
+	}
+	for (idx_t v = 0; v < bind_data.value_count; v++) {
+		for (idx_t k = 0; k < bind_data.key_count; k++) {
+			auto column = bind_data.ValueColumn(v) + k * bind_data.ValueStride(v);
+			state.output_types[column] = input_types[bind_data.ValueIndex(v)];
+		}
+	}
+
+	unordered_map<string, idx_t> row_indexes;
+	vector<string> group_keys;
+	idx_t input_index = 0;
+	state.output_rows.reserve(bind_data.input->RowCount());
+	for (auto &chunk : bind_data.input->Collection().Chunks()) {
+		group_keys.assign(chunk.size(), string());
+		for (idx_t i = 0; i < bind_data.group_count; i++) {
+			AppendGroupKeys(chunk.data[1 + i], chunk.size(), group_keys);
+		}
+		for (idx_t row = 0; row < chunk.size(); row++) {
+			auto entry = row_indexes.emplace(std::move(group_keys[row]), row_indexes.size());
+			auto output_chunk = entry.first->second / STANDARD_VECTOR_SIZE;
+			if (output_chunk == state.last_input_chunks.size()) {
+				state.last_input_chunks.push_back(input_index);
+			}
+			state.last_input_chunks[output_chunk] = input_index;
+			state.output_rows.push_back(entry.first->second);
+		}
+		input_index++;
+	}
+	state.completed_chunks.resize(state.last_input_chunks.size());
+	for (idx_t c = 0; c < state.completed_chunks.size(); c++) {
+		state.completed_chunks[c] = c;
+	}
+	std::stable_sort(state.completed_chunks.begin(), state.completed_chunks.end(),
+	                 [&](idx_t a, idx_t b) { return state.last_input_chunks[a] < state.last_input_chunks[b]; });
+	state.output_chunks.resize(state.last_input_chunks.size());
+	state.started_per_chunk.resize(state.last_input_chunks.size());
+	state.cells_per_chunk.resize(state.last_input_chunks.size());
+}
+
+//! Lay out the next input chunk into the output chunks that it fills in (only those are touched). Once it is laid out,
+//! the output chunks that no later input chunk has a row of are complete.
+static void LayOutUnorderedInput(const PivotTableNativeBindData &bind_data, PivotTableNativeState &state) {
+	auto &input = state.input_chunk;
+	input.Reset();
+	if (!bind_data.input->Collection().Scan(state.scan_state, input)) {
+		state.finished = true;
+		return;
+	}
+	state.touched_chunks.clear();
+	for (idx_t row = 0; row < input.size(); row++) {
+		auto output_row = state.output_rows[state.input_start + row];
+		auto output_chunk = output_row / STANDARD_VECTOR_SIZE;
+		auto &started = state.started_per_chunk[output_chunk];
+		auto &cells = state.cells_per_chunk[output_chunk];
+		auto row_offset = bind_data.row_offsets[state.input_start + row];
+		if (started.count == 0 && cells.count == 0 &&
+		    (output_row == state.started_rows || row_offset != DConstants::INVALID_INDEX)) {
+			state.touched_chunks.push_back(output_chunk);
+		}
+		if (output_row == state.started_rows) {
+			// The first row of an output chunk is started by the first input row that belongs to it
+			if (output_row % STANDARD_VECTOR_SIZE == 0) {
+				state.output_chunks[output_chunk] = make_uniq<DataChunk>();
+				state.output_chunks[output_chunk]->Initialize(Allocator::DefaultAllocator(), state.output_types);
+			}
+			started.Add(row, output_row % STANDARD_VECTOR_SIZE, 0);
+			state.started_rows++;
+		}
+		if (row_offset != DConstants::INVALID_INDEX) {
+			cells.Add(row, output_row % STANDARD_VECTOR_SIZE, row_offset);
+		}
+	}
+	for (auto output_chunk : state.touched_chunks) {
+		auto &started = state.started_per_chunk[output_chunk];
+		auto &cells = state.cells_per_chunk[output_chunk];
+		CopyRows(bind_data, input, *state.output_chunks[output_chunk], started, cells);
+		started.Clear();
+		cells.Clear();
+	}
+	state.input_start += input.size();
+	state.input_index++;
+}
+
+static unique_ptr<PivotTableNativeState> InitializeState(const PivotTableNativeBindData &bind_data) {
+	auto result = make_uniq<PivotTableNativeState>();
+	if (bind_data.long_format) {
+		// Only scan the output columns: the input without the dummy_column and the empty values
+		vector<column_t> column_ids;
+		for (idx_t i = 1; i < bind_data.EmptyValueIndex(0); i++) {
+			column_ids.push_back(i);
+		}
+		bind_data.input->Collection().InitializeScan(result->scan_state, std::move(column_ids));
+		return std::move(result);
+	}
+	if (!bind_data.ordered) {
+		GroupUnorderedInput(bind_data, *result);
+	}
+	auto &collection = bind_data.input->Collection();
+	collection.InitializeScan(result->scan_state);
+	collection.InitializeScanChunk(result->input_chunk);
+	return std::move(result);
+}
+
+static unique_ptr<GlobalTableFunctionState> PivotTableNativeInit(ClientContext &context,
+                                                                 TableFunctionInitInput &input) {
+	auto &bind_data = input.bind_data->Cast<PivotTableNativeBindData>();
+	if (bind_data.on_execute) {
+		bind_data.on_execute(context);
+	}
+	return InitializeState(bind_data);
+}
+
+static void ScanOutput(const PivotTableNativeBindData &bind_data, PivotTableNativeState &state, DataChunk &output) {
+	auto &collection = bind_data.input->Collection();
+	auto max_rows = bind_data.max_rows.IsValid() ? bind_data.max_rows.GetIndex() : NumericLimits<idx_t>::Maximum();
+
+	if (bind_data.long_format) {
+		// The input already has a row per pivot key, so it is returned as it is
+		if (state.emitted < max_rows && collection.Scan(state.scan_state, output)) {
+			output.SetCardinality(MinValue<idx_t>(output.size(), max_rows - state.emitted));
+			state.emitted += output.size();
+		}
+		return;
+	}
+
+	if (!bind_data.ordered) {
+		// Each output chunk is returned once the last input chunk with a row of it is laid out
+		auto &completed = state.completed_chunks;
+		while (state.emitted < max_rows && state.next_completed < completed.size() && !state.finished &&
+		       state.last_input_chunks[completed[state.next_completed]] >= state.input_index) {
+			LayOutUnorderedInput(bind_data, state);
+		}
+		if (state.emitted < max_rows && state.next_completed < completed.size()) {
+			auto output_chunk = completed[state.next_completed++];
+			// Every row of a complete output chunk has started
+			auto size = MinValue<idx_t>(state.started_rows - output_chunk * STANDARD_VECTOR_SIZE, STANDARD_VECTOR_SIZE);
+			state.returned = std::move(state.output_chunks[output_chunk]);
+			state.returned->SetCardinality(size);
+			output.Reference(*state.returned);
+			output.SetCardinality(MinValue<idx_t>(output.size(), max_rows - state.emitted));
+			state.emitted += output.size();
+		}
+		return;
+	}
+
+	// The cells are copied from the input into the output a vector at a time (see LayOutInput)
+	idx_t count = 0;
+	auto capacity = MinValue<idx_t>(STANDARD_VECTOR_SIZE, max_rows - state.emitted);
+	while (!state.finished) {
+		if (state.input_offset >= state.input_chunk.size()) {
+			state.input_start += state.input_chunk.size();
+			state.input_chunk.Reset();
+			state.input_offset = 0;
+			if (!collection.Scan(state.scan_state, state.input_chunk)) {
+				state.finished = true;
+			}
+			continue;
+		}
+		if (!LayOutInput(bind_data, state, output, count, capacity)) {
+			state.finished = state.emitted + count >= max_rows;
+			break;
+		}
+	}
+	state.emitted += count;
+	output.SetCardinality(count);
+}
+
+static void PivotTableNativeScan(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	ScanOutput(data_p.bind_data->Cast<PivotTableNativeBindData>(), data_p.global_state->Cast<PivotTableNativeState>(),
+	           output);
+}
+
+idx_t PivotTableNativeFunction::AppendOutput(const FunctionData &bind_data_p, const vector<LogicalType> &types,
+                                             Appender &appender) {
+	auto &bind_data = bind_data_p.Cast<PivotTableNativeBindData>();
+	auto state = InitializeState(bind_data);
+	DataChunk output;
+	output.Initialize(Allocator::DefaultAllocator(), types);
+	idx_t count = 0;
+	while (true) {
+		output.Reset();
+		ScanOutput(bind_data, *state, output);
+		if (output.size() == 0) {
+			return count;
+		}
+		appender.AppendDataChunk(output);
+		count += output.size();
+	}
+}
+
+TableFunction PivotTableNativeFunction::CreateFunction(const string &name, vector<LogicalType> arguments,
+                                                       table_function_bind_t bind) {
+	return TableFunction(name, std::move(arguments), PivotTableNativeScan, bind, PivotTableNativeInit);
+}
+
+TableFunction PivotTableNativeFunction::GetFunction() {
+	auto string_list = LogicalType::LIST(LogicalType::VARCHAR);
+	auto function = CreateFunction("pivot_table_native",
+	                               {string_list, string_list, string_list, string_list, string_list},
+	                               PivotTableNativeBind);
+	function.bind_replace = PivotTableNativeBindReplace;
+	function.named_parameters["values_axis"] = LogicalType::VARCHAR;
+	function.named_parameters["subtotals"] = LogicalType::BOOLEAN;
+	function.named_parameters["grand_totals"] = LogicalType::BOOLEAN;
+	function.named_parameters["ordered"] = LogicalType::BOOLEAN;
+	function.named_parameters["max_rows"] = LogicalType::BIGINT;
+	function.named_parameters["max_pivot_keys"] = LogicalType::BIGINT;
+	function.named_parameters["overflow"] = LogicalType::VARCHAR;
+	function.named_parameters["rank_by"] = LogicalType::VARCHAR;
+	function.named_parameters["approx"] = LogicalType::BOOLEAN;
+	function.named_parameters["sample_fraction"] = LogicalType::DOUBLE;
+	function.named_parameters["sample_seed"] = LogicalType::BIGINT;
+	function.named_parameters["partitions"] = LogicalType::BIGINT;
+	return function;
+}
+
+} // namespace duckdb
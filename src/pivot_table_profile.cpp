@@ -0,0 +1,437 @@
+#include "pivot_table_profile.hpp"
+#include "pivot_table_cache.hpp"
+#include "pivot_table_native.hpp"
+#include "pivot_table_sql.hpp"
+
+#include "duckdb/common/enums/physical_operator_type.hpp"
+#include "duckdb/common/exception.hpp"
+#include "duckdb/common/profiler.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/common/unordered_set.hpp"
+#include "duckdb/function/table_function.hpp"
+#include "duckdb/main/client_context.hpp"
+#include "duckdb/main/connection.hpp"
+#include "duckdb/main/materialized_query_result.hpp"
+#include "duckdb/main/prepared_statement.hpp"
+#include "duckdb/main/profiling_node.hpp"
+#include "duckdb/main/query_profiler.hpp"
+#include "duckdb/parser/parser.hpp"
+#include "duckdb/storage/buffer_manager.hpp"
+
+#include <atomic>
+#include <cstring>
+#ifndef DUCKDB_NO_THREADS
+#include <thread>
+#endif
+
+namespace duckdb {
+
+//===--------------------------------------------------------------------===//
+// Query profile
+//===--------------------------------------------------------------------===//
+//! An operator of DuckDB's query profile (see QueryProfiler::GetRoot)
+struct PivotTableProfileOperator {
+	string name;
+	//! The extra info of the operator (Ex: the table of a scan), a "key: value" line per property
+	string extra_info;
+	double seconds = 0;
+	idx_t cardinality = 0;
+	//! Only reported by some versions for scans
+	optional_idx rows_scanned;
+};
+
+//! The value of a metric of a profiling node, or nullptr if it was not collected (see custom_profiling_settings)
+static optional_ptr<const Value> GetMetric(const ProfilingInfo &info, MetricsType metric) {
+	auto entry = info.metrics.find(metric);
+	if (entry == info.metrics.end() || entry->second.IsNull()) {
+		return nullptr;
+	}
+	return &entry->second;
+}
+
+//! Add the operators below a node of the query profile, each followed by its children. The root is the query itself,
+//! not an operator.
+static void ReadOperators(ProfilingNode &node, vector<PivotTableProfileOperator> &result) {
+	for (idx_t i = 0; i < node.GetChildCount(); i++) {
+		auto &child = *node.GetChild(i);
+		auto &info = child.GetProfilingInfo();
+		PivotTableProfileOperator op;
+		if (child.GetProfilingNodeType() == ProfilingNodeType::OPERATOR) {
+			op.name = PhysicalOperatorToString(child.Cast<OperatorProfilingNode>().type);
+		}
+		for (auto &entry : info.extra_info) {
+			op.extra_info += (op.extra_info.empty() ? "" : "\n") + entry.first + ": " + entry.second;
+		}
+		auto seconds = GetMetric(info, MetricsType::OPERATOR_TIMING);
+		if (seconds) {
+			op.seconds = seconds->GetValue<double>();
+		}
+		auto cardinality = GetMetric(info, MetricsType::OPERATOR_CARDINALITY);
+		if (cardinality) {
+			op.cardinality = cardinality->GetValue<idx_t>();
+		}
+		auto rows_scanned = GetMetric(info, MetricsType::OPERATOR_ROWS_SCANNED);
+		if (rows_scanned) {
+			op.rows_scanned = optional_idx(rows_scanned->GetValue<idx_t>());
+		}
+		if (!op.name.empty()) {
+			result.push_back(std::move(op));
+		}
+		ReadOperators(child, result);
+	}
+}
+
+static void EnableProfiling(Connection &con) {
+	auto enabled = con.Query("PRAGMA enable_profiling = 'no_output'");
+	if (enabled->HasError()) {
+		enabled->ThrowError();
+	}
+}
+
+//! Add the operators of the last query that ran on the connection, which must be read before the next query replaces
+//! its profile
+static void ReadProfile(Connection &con, vector<PivotTableProfileOperator> &operators) {
+	auto root = QueryProfiler::Get(*con.context).GetRoot();
+	if (root) {
+		ReadOperators(*root, operators);
+	}
+}
+
+static bool IsSourceScan(const string &name) {
+	// Scans of intermediate results (CTEs, materialized chunks, ...) do not read the source tables
+	static const char *const INTERMEDIATE_SCANS[] = {"COLUMN_DATA_SCAN", "CTE_SCAN",   "RECURSIVE_CTE_SCAN",
+	                                                 "DELIM_SCAN",       "CHUNK_SCAN", "DUMMY_SCAN",
+	                                                 "EXPRESSION_SCAN",  "POSITIONAL_SCAN"};
+	if (!StringUtil::Contains(name, "SCAN") && !StringUtil::StartsWith(name, "READ_")) {
+		return false;
+	}
+	for (auto scan : INTERMEDIATE_SCANS) {
+		if (name == scan) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static string ScanSource(const PivotTableProfileOperator &op) {
+	// The extra info has a line per property (Ex: "Table: my_table"). Older versions only list the table name.
+	for (auto &line : StringUtil::Split(op.extra_info, "\n")) {
+		for (auto prefix : {"Table: ", "Function: ", "Text: "}) {
+			if (StringUtil::StartsWith(line, prefix)) {
+				return line.substr(strlen(prefix));
+			}
+		}
+	}
+	auto lines = StringUtil::Split(op.extra_info, "\n");
+	return lines.empty() ? op.name : lines[0];
+}
+
+//===--------------------------------------------------------------------===//
+// Bind
+//===--------------------------------------------------------------------===//
+struct PivotTableProfileMetric {
+	string metric;
+	double value;
+	string detail;
+};
+
+struct PivotTableProfileBindData : public TableFunctionData {
+	vector<PivotTableProfileMetric> metrics;
+};
+
+//! The peak memory of the buffer manager while the query runs, sampled every millisecond, above the memory that was
+//! already in use when it started. The buffer manager is shared by the whole database, so other queries that run at
+//! the same time are counted too.
+//! Without threads (Ex: in WebAssembly) only the memory after running the query is known.
+class PivotTableMemorySampler {
+public:
+	explicit PivotTableMemorySampler(BufferManager &buffer_manager)
+	    : buffer_manager(buffer_manager), start(buffer_manager.GetUsedMemory()), peak(start) {
+#ifndef DUCKDB_NO_THREADS
+		sampler = std::thread([this]() {
+			while (!finished) {
+				Sample();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+#endif
+	}
+
+	idx_t Finish() {
+		finished = true;
+#ifndef DUCKDB_NO_THREADS
+		if (sampler.joinable()) {
+			sampler.join();
+		}
+#endif
+		Sample();
+		return peak - start;
+	}
+
+	~PivotTableMemorySampler() {
+		Finish();
+	}
+
+private:
+	void Sample() {
+		idx_t used = buffer_manager.GetUsedMemory();
+		idx_t current = peak;
+		while (used > current && !peak.compare_exchange_weak(current, used)) {
+		}
+	}
+
+	BufferManager &buffer_manager;
+	idx_t start;
+	std::atomic<idx_t> peak;
+	std::atomic<bool> finished {false};
+#ifndef DUCKDB_NO_THREADS
+	std::thread sampler;
+#endif
+};
+
+static string JoinQuoted(const vector<string> &list) {
+	vector<string> quoted;
+	for (auto &entry : list) {
+		quoted.push_back(PivotTableSQLBuilder::DQ(entry));
+	}
+	return StringUtil::Join(quoted, ", ");
+}
+
+static void AddPivotMetrics(const PivotTableArguments &args, vector<PivotTableProfileMetric> &metrics) {
+	// The levels that the GROUPING SETS aggregate (see PivotTableSQLBuilder::AppendGroupingSets)
+	vector<string> levels {"(" + JoinQuoted(args.rows) + ")"};
+	for (idx_t level = args.rows.size(); level > 0; level--) {
+		bool is_grand_total = level == 1;
+		if ((!is_grand_total && args.subtotals) || (is_grand_total && args.grand_totals)) {
+			vector<string> kept;
+			for (idx_t r = 0; r + 1 < level; r++) {
+				kept.push_back(args.rows[r]);
+			}
+			levels.push_back("(" + JoinQuoted(kept) + ")");
+		}
+	}
+	metrics.push_back({"rollup_levels", double(levels.size()), StringUtil::Join(levels, ", ")});
+	auto values = args.values.empty() ? vector<string> {"count(*)"} : args.values;
+	metrics.push_back({"value_expressions", double(values.size()), StringUtil::Join(values, ", ")});
+}
+
+static idx_t CountPivotKeys(const PivotTableArguments &args, bool native, MaterializedQueryResult &result) {
+	if (args.columns.empty()) {
+		return 0;
+	}
+	idx_t group_count = args.rows.size() + (args.ValuesOnRows() ? 1 : 0);
+	if (!native) {
+		// pivot_table: the dummy_column and the group columns, then a column per key (and per value on columns)
+		idx_t per_key = args.ValuesOnRows() ? 1 : MaxValue<idx_t>(args.values.size(), 1);
+		return (result.ColumnCount() - 1 - group_count) / per_key;
+	}
+	// pivot_table_native: a row per key in long format (see PivotTableSQLBuilder::NativeInput)
+	unordered_set<string> keys;
+	for (auto &chunk : result.Collection().Chunks()) {
+		for (idx_t row = 0; row < chunk.size(); row++) {
+			auto key = chunk.GetValue(1 + group_count, row);
+			if (!key.IsNull()) {
+				keys.insert(StringValue::Get(key));
+			}
+		}
+	}
+	return keys.size();
+}
+
+static void AddOperatorMetrics(const vector<PivotTableProfileOperator> &operators,
+                               vector<PivotTableProfileMetric> &metrics) {
+	vector<string> sources;
+	vector<PivotTableProfileMetric> scans;
+	vector<PivotTableProfileMetric> aggregates;
+	double scan_seconds = 0, aggregate_seconds = 0, window_seconds = 0, sort_seconds = 0, total_seconds = 0;
+	for (auto &op : operators) {
+		total_seconds += op.seconds;
+		if (IsSourceScan(op.name)) {
+			auto source = ScanSource(op);
+			sources.push_back(source);
+			auto rows = op.rows_scanned.IsValid() ? op.rows_scanned.GetIndex() : op.cardinality;
+			scans.push_back({"rows_read", double(rows), source});
+			scan_seconds += op.seconds;
+		} else if (StringUtil::Contains(op.name, "GROUP_BY") || op.name == "UNGROUPED_AGGREGATE") {
+			// The output of an aggregate is one row per group, so this is the size of its hash table
+			aggregates.push_back({"aggregate_groups", double(op.cardinality), op.name});
+			aggregate_seconds += op.seconds;
+		} else if (StringUtil::Contains(op.name, "WINDOW")) {
+			window_seconds += op.seconds;
+		} else if (op.name == "ORDER_BY" || op.name == "TOP_N") {
+			sort_seconds += op.seconds;
+		}
+	}
+	metrics.push_back({"source_scans", double(sources.size()), StringUtil::Join(sources, ", ")});
+	metrics.insert(metrics.end(), scans.begin(), scans.end());
+	metrics.insert(metrics.end(), aggregates.begin(), aggregates.end());
+	metrics.push_back({"scan_seconds", scan_seconds, "reading and filtering the source tables"});
+	metrics.push_back({"aggregate_seconds", aggregate_seconds, "every rollup level and pivot key"});
+	metrics.push_back({"window_seconds", window_seconds, "naming the pivot keys"});
+	metrics.push_back({"sort_seconds", sort_seconds, "ordering the output rows"});
+	metrics.push_back({"operator_seconds", total_seconds, "all operators"});
+}
+
+static unique_ptr<FunctionData> PivotTableProfileBind(ClientContext &context, TableFunctionBindInput &input,
+                                                      vector<LogicalType> &return_types, vector<string> &names) {
+	names.emplace_back("metric");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	names.emplace_back("value");
+	return_types.emplace_back(LogicalType::DOUBLE);
+	names.emplace_back("detail");
+	return_types.emplace_back(LogicalType::VARCHAR);
+
+	auto args = PivotTableArguments::FromValues("pivot_table_profile", input.inputs, input.named_parameters);
+	PivotTablePlanCache::CheckSnapshot(context, input, "pivot_table_profile", args.table_names);
+	bool native = false;
+	for (auto &kv : input.named_parameters) {
+		if (StringUtil::Lower(kv.first) == "native" && !kv.second.IsNull()) {
+			native = BooleanValue::Get(kv.second);
+		}
+	}
+	auto result = make_uniq<PivotTableProfileBindData>();
+	auto &metrics = result->metrics;
+
+	// With partitions, the statement that is profiled finalizes the partials of every partition (see WritePartitions).
+	// Like in pivot_table_native, there is nothing to partition without columns.
+	bool partitioned = native && args.partitions > 1 && !args.columns.empty();
+	Profiler timer;
+	timer.Start();
+	string sql;
+	if (partitioned) {
+		sql = PivotTableSQLBuilder(args)
+		          .CombineByName()
+		          .FromPartitions(PivotTableNativeFunction::PARTITIONS_TABLE)
+		          .NativeInput();
+	} else if (native) {
+		sql = PivotTableSQLBuilder(args).CombineByName().NativeInput();
+	} else {
+		sql = PivotTableSQLBuilder(args).PivotTable();
+	}
+	timer.End();
+	metrics.push_back({"sql_bytes", double(sql.size()), native ? "pivot_table_native" : "pivot_table"});
+	metrics.push_back({"sql_generation_seconds", timer.Elapsed(), ""});
+
+	timer.Start();
+	Parser parser(context.GetParserOptions());
+	parser.ParseQuery(sql);
+	timer.End();
+	metrics.push_back({"parse_seconds", timer.Elapsed(), ""});
+
+	// The query runs on the same separate connection as pivot_table_native, with profiling enabled only for it
+	auto plan_cache = PivotTablePlanCache::Get(context);
+	lock_guard<mutex> guard(plan_cache->lock);
+	auto &con = plan_cache->GetConnection(context);
+	idx_t peak_memory = 0;
+	vector<PivotTableProfileOperator> operators;
+	if (partitioned) {
+		// The operators of the scan of the tables and of every partition are reported with those of the final statement
+		EnableProfiling(con);
+		PivotTableMemorySampler sampler(BufferManager::GetBufferManager(*context.db));
+		timer.Start();
+		try {
+			PivotTableNativeFunction::WritePartitions(con, "pivot_table_profile", args,
+			                                          [&]() { ReadProfile(con, operators); });
+		} catch (std::exception &) {
+			con.Query("PRAGMA disable_profiling");
+			throw;
+		}
+		timer.End();
+		peak_memory = sampler.Finish();
+		con.Query("PRAGMA disable_profiling");
+		metrics.push_back({"partitions", double(args.partitions), "aggregated one at a time"});
+		metrics.push_back({"partition_seconds", timer.Elapsed(), "aggregating the partials of every partition"});
+	}
+	timer.Start();
+	auto prepared = con.Prepare(sql);
+	if (prepared->HasError() && native && !partitioned && args.aggregate_in_parts &&
+	    PivotTableIsBindError(prepared->GetErrorObject())) {
+		// Like pivot_table_native, aggregate directly when a simple value can not be aggregated in parts
+		args.aggregate_in_parts = false;
+		sql = PivotTableSQLBuilder(args).CombineByName().NativeInput();
+		prepared = con.Prepare(sql);
+	}
+	timer.End();
+	if (prepared->HasError()) {
+		if (partitioned) {
+			PivotTableNativeFunction::DropPartitions(con);
+		}
+		prepared->GetErrorObject().Throw();
+	}
+	metrics.push_back({"plan_seconds", timer.Elapsed(), "binding and optimizing"});
+
+	EnableProfiling(con);
+	unique_ptr<QueryResult> query_result;
+	{
+		PivotTableMemorySampler sampler(BufferManager::GetBufferManager(*context.db));
+		timer.Start();
+		vector<Value> parameters;
+		query_result = prepared->Execute(parameters, false);
+		timer.End();
+		peak_memory = MaxValue<idx_t>(peak_memory, sampler.Finish());
+	}
+	ReadProfile(con, operators);
+	con.Query("PRAGMA disable_profiling");
+	if (partitioned) {
+		PivotTableNativeFunction::DropPartitions(con);
+	}
+	if (query_result->HasError()) {
+		query_result->ThrowError();
+	}
+	auto materialized_result = unique_ptr_cast<QueryResult, MaterializedQueryResult>(std::move(query_result));
+	auto &materialized = *materialized_result;
+	metrics.push_back({"execute_seconds", timer.Elapsed(), ""});
+	metrics.push_back({"output_rows", double(materialized.RowCount()), ""});
+	metrics.push_back(
+	    {"peak_buffer_memory_bytes", double(peak_memory), "sampled while executing, above the memory in use before"});
+
+	AddPivotMetrics(args, metrics);
+	metrics.push_back({"pivot_keys", double(CountPivotKeys(args, native, materialized)), ""});
+	AddOperatorMetrics(operators, metrics);
+	return std::move(result);
+}
+
+//===--------------------------------------------------------------------===//
+// Scan
+//===--------------------------------------------------------------------===//
+struct PivotTableProfileState : public GlobalTableFunctionState {
+	idx_t offset = 0;
+};
+
+static unique_ptr<GlobalTableFunctionState> PivotTableProfileInit(ClientContext &context,
+                                                                  TableFunctionInitInput &input) {
+	return make_uniq<PivotTableProfileState>();
+}
+
+static void PivotTableProfileScan(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &bind_data = data_p.bind_data->Cast<PivotTableProfileBindData>();
+	auto &state = data_p.global_state->Cast<PivotTableProfileState>();
+	idx_t count = 0;
+	while (state.offset < bind_data.metrics.size() && count < STANDARD_VECTOR_SIZE) {
+		auto &metric = bind_data.metrics[state.offset++];
+		output.SetValue(0, count, Value(metric.metric));
+		output.SetValue(1, count, Value::DOUBLE(metric.value));
+		output.SetValue(2, count, metric.detail.empty() ? Value() : Value(metric.detail));
+		count++;
+	}
+	output.SetCardinality(count);
+}
+
+TableFunction PivotTableProfileFunction::GetFunction() {
+	auto string_list = LogicalType::LIST(LogicalType::VARCHAR);
+	TableFunction function("pivot_table_profile", {string_list, string_list, string_list, string_list, string_list},
+	                       PivotTableProfileScan, PivotTableProfileBind, PivotTableProfileInit);
+	function.named_parameters["values_axis"] = LogicalType::VARCHAR;
+	function.named_parameters["subtotals"] = LogicalType::BOOLEAN;
+	function.named_parameters["grand_totals"] = LogicalType::BOOLEAN;
+	function.named_parameters["ordered"] = LogicalType::BOOLEAN;
+	function.named_parameters["max_rows"] = LogicalType::BIGINT;
+	function.named_parameters["approx"] = LogicalType::BOOLEAN;
+	function.named_parameters["sample_fraction"] = LogicalType::DOUBLE;
+	function.named_parameters["sample_seed"] = LogicalType::BIGINT;
+	function.named_parameters["partitions"] = LogicalType::BIGINT;
+	function.named_parameters["native"] = LogicalType::BOOLEAN;
+	return function;
+}
+
+} // namespace duckdb
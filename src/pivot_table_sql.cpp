@@ -0,0 +1,1295 @@
+#include "pivot_table_sql.hpp"
+
+#include "duckdb/common/exception.hpp"
+#include "duckdb/common/numeric_utils.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/function/scalar_function.hpp"
+#include "duckdb/parser/qualified_name.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace duckdb {
+
+//===--------------------------------------------------------------------===//
+// Arguments
+//===--------------------------------------------------------------------===//
+static const char *const LIST_PARAMETERS[] = {"table_names", "values", "rows", "columns", "filters"};
+
+static vector<string> ParseStringList(const string &function_name, const Value &list, const string &name) {
+	vector<string> result;
+	if (list.IsNull()) {
+		return result;
+	}
+	for (auto &child : ListValue::GetChildren(list)) {
+		if (child.IsNull()) {
+			throw InvalidInputException("%s: the %s parameter can not contain NULL", function_name, name);
+		}
+		result.push_back(child.ToString());
+	}
+	return result;
+}
+
+PivotTableArguments PivotTableArguments::FromValues(const string &function_name, const vector<Value> &lists,
+                                                    const named_parameter_map_t &options) {
+	D_ASSERT(lists.size() == 5);
+	PivotTableArguments result;
+	vector<string> *targets[] = {&result.table_names, &result.values, &result.rows, &result.columns,
+	                             &result.filters};
+	for (idx_t i = 0; i < 5; i++) {
+		*targets[i] = ParseStringList(function_name, lists[i], LIST_PARAMETERS[i]);
+	}
+	for (auto &option : options) {
+		if (option.second.IsNull()) {
+			continue;
+		}
+		auto loption = StringUtil::Lower(option.first);
+		if (loption == "values_axis") {
+			result.values_axis = option.second.ToString();
+		} else if (loption == "subtotals") {
+			result.subtotals = option.second.GetValue<bool>();
+		} else if (loption == "grand_totals") {
+			result.grand_totals = option.second.GetValue<bool>();
+		} else if (loption == "ordered") {
+			result.ordered = option.second.GetValue<bool>();
+		} else if (loption == "max_rows") {
+			auto max_rows = option.second.GetValue<int64_t>();
+			if (max_rows < 0) {
+				throw InvalidInputException("%s: max_rows can not be negative", function_name);
+			}
+			result.max_rows = optional_idx(NumericCast<idx_t>(max_rows));
+		} else if (loption == "max_pivot_keys") {
+			auto max_pivot_keys = option.second.GetValue<int64_t>();
+			if (max_pivot_keys < 1) {
+				throw InvalidInputException("%s: max_pivot_keys must be at least 1", function_name);
+			}
+			result.max_pivot_keys = optional_idx(NumericCast<idx_t>(max_pivot_keys));
+		} else if (loption == "overflow") {
+			result.overflow = option.second.ToString();
+		} else if (loption == "rank_by") {
+			result.rank_by = option.second.ToString();
+		} else if (loption == "approx") {
+			result.approx = option.second.GetValue<bool>();
+		} else if (loption == "sample_fraction") {
+			auto sample_fraction = option.second.GetValue<double>();
+			if (!(sample_fraction > 0 && sample_fraction <= 1)) {
+				throw InvalidInputException("%s: sample_fraction must be greater than 0 and at most 1", function_name);
+			}
+			result.sample_fraction = sample_fraction;
+		} else if (loption == "sample_seed") {
+			auto sample_seed = option.second.GetValue<int64_t>();
+			if (sample_seed < 0) {
+				throw InvalidInputException("%s: sample_seed can not be negative", function_name);
+			}
+			result.sample_seed = optional_idx(NumericCast<idx_t>(sample_seed));
+		} else if (loption == "partitions") {
+			auto partitions = option.second.GetValue<int64_t>();
+			if (partitions < 1) {
+				throw InvalidInputException("%s: partitions must be at least 1", function_name);
+			}
+			result.partitions = NumericCast<idx_t>(partitions);
+		}
+	}
+	if (result.values_axis != "columns" && result.values_axis != "rows") {
+		throw InvalidInputException("%s: values_axis must be 'columns' or 'rows', not '%s'", function_name,
+		                            result.values_axis);
+	}
+	if (result.overflow != "error" && result.overflow != "other" && result.overflow != "long") {
+		throw InvalidInputException("%s: overflow must be 'error', 'other' or 'long', not '%s'", function_name,
+		                            result.overflow);
+	}
+	if (result.values.empty() && result.rows.empty() && result.columns.empty()) {
+		throw InvalidInputException("%s requires at least one element in the values, rows or columns parameters",
+		                            function_name);
+	}
+	if (result.sample_seed.IsValid() && !result.Sampled()) {
+		throw InvalidInputException("%s: sample_seed requires a sample_fraction", function_name);
+	}
+	if (result.Sampled()) {
+		// Every cell also counts the rows of the sample that it aggregates (see AggregateExpression), after the
+		// values that are estimated from them
+		if (result.values.empty()) {
+			throw InvalidInputException(
+			    "%s: sample_fraction requires at least one value to estimate (Ex: ['count(*)'])", function_name);
+		}
+		for (auto &value : result.values) {
+			if (value == "sample_rows") {
+				throw InvalidInputException("%s: sample_rows can not be a value with a sample_fraction, it is "
+				                            "added to count the rows of the sample",
+				                            function_name);
+			}
+		}
+		result.values.emplace_back("sample_rows");
+	}
+	return result;
+}
+
+static string StringListToSQL(const vector<string> &list) {
+	string result = "[";
+	for (idx_t i = 0; i < list.size(); i++) {
+		result += (i == 0 ? "" : ", ") + PivotTableSQLBuilder::SQ(list[i]);
+	}
+	return result + "]::VARCHAR[]";
+}
+
+string PivotTableArguments::ToSQL() const {
+	return StringListToSQL(table_names) + ", " + StringListToSQL(values) + ", " + StringListToSQL(rows) + ", " +
+	       StringListToSQL(columns) + ", " + StringListToSQL(filters) +
+	       ", values_axis := " + PivotTableSQLBuilder::SQ(values_axis) +
+	       ", subtotals := " + (subtotals ? "true" : "false") + ", grand_totals := " + (grand_totals ? "true" : "false") +
+	       ", ordered := " + (ordered ? "true" : "false") +
+	       ", max_rows := " + (max_rows.IsValid() ? to_string(max_rows.GetIndex()) : "NULL") +
+	       ", max_pivot_keys := " + (max_pivot_keys.IsValid() ? to_string(max_pivot_keys.GetIndex()) : "NULL") +
+	       ", overflow := " + PivotTableSQLBuilder::SQ(overflow) + ", rank_by := " + PivotTableSQLBuilder::SQ(rank_by) +
+	       ", approx := " + (approx ? "true" : "false") +
+	       ", sample_fraction := " + Value::DOUBLE(sample_fraction).ToString() +
+	       ", sample_seed := " + (sample_seed.IsValid() ? to_string(sample_seed.GetIndex()) : "NULL") +
+	       ", aggregate_in_parts := " + (aggregate_in_parts ? "true" : "false");
+}
+
+//===--------------------------------------------------------------------===//
+// Quoting
+//===--------------------------------------------------------------------===//
+string PivotTableSQLBuilder::NQ(const string &text) {
+	// We do not want to allow semicolons because we do not want to allow multiple statements to be run.
+	// This combines with the query function's boundaries of only running a single statement
+	// and only running read queries to protect against unwanted execution.
+	return StringUtil::Replace(text, ";", "No semicolons are permitted here");
+}
+
+string PivotTableSQLBuilder::SQ(const string &text) {
+	return "'" + StringUtil::Replace(text, "'", "''") + "'";
+}
+
+string PivotTableSQLBuilder::DQ(const string &text) {
+	return "\"" + StringUtil::Replace(text, "\"", "\"\"") + "\"";
+}
+
+string PivotTableSQLBuilder::TableReference(const string &table_name) {
+	auto name = QualifiedName::Parse(table_name);
+	string result;
+	for (auto part : {&name.catalog, &name.schema}) {
+		if (!part->empty()) {
+			result += DQ(*part) + ".";
+		}
+	}
+	return result + DQ(name.name);
+}
+
+//===--------------------------------------------------------------------===//
+// Builder
+//===--------------------------------------------------------------------===//
+static idx_t EstimateSize(const vector<string> &list) {
+	idx_t result = 0;
+	for (auto &entry : list) {
+		// Leave room for the quotes and the separator
+		result += entry.size() + 4;
+	}
+	return result;
+}
+
+PivotTableSQLBuilder::PivotTableSQLBuilder(const PivotTableArguments &args) : args(args) {
+	// The statement is a fixed template of about 2KB. The rows are repeated the most (in the grouping sets,
+	// the labels and the ORDER BY), so size the buffer for several copies of every argument.
+	idx_t arguments_size = EstimateSize(args.table_names) + EstimateSize(args.values) + EstimateSize(args.rows) +
+	                       EstimateSize(args.columns) + EstimateSize(args.filters);
+	sql.reserve(2048 + 8 * arguments_size + 64 * args.rows.size() * args.rows.size());
+}
+
+void PivotTableSQLBuilder::AppendQuoted(const vector<string> &list, const string &separator,
+                                        string (*quote)(const string &)) {
+	for (idx_t i = 0; i < list.size(); i++) {
+		if (i > 0) {
+			Append(separator);
+		}
+		Append(quote(list[i]));
+	}
+}
+
+void PivotTableSQLBuilder::AppendFiltered() {
+	// Every statement reads the raw data through this one filtered relation, so each filter is written (and evaluated)
+	// once no matter how many levels of totals or values there are. The WHERE clause is entirely removed if filters is
+	// an empty list. It is not materialized: inlining it lets the optimizer push the filters and the used columns
+	// into the table scans, where they can skip row groups (or Parquet files and row groups) entirely.
+	Append("filtered AS NOT MATERIALIZED (\nFROM ");
+	if (by_name && args.table_names.size() > 1) {
+		Append("(");
+		for (idx_t t = 0; t < args.table_names.size(); t++) {
+			Append((t == 0 ? "FROM query_table([" : " UNION ALL BY NAME FROM query_table([") + DQ(args.table_names[t]) +
+			       "])" + SampleClause());
+		}
+		Append(")");
+	} else {
+		Append("query_table([");
+		AppendQuoted(args.table_names, ", ", DQ);
+		Append("])" + SampleClause());
+	}
+	Append("\nSELECT *");
+	if (!args.filters.empty()) {
+		Append("\nWHERE 1=1 AND ");
+		AppendQuoted(args.filters, " AND ", NQ);
+	}
+	Append("\n)");
+}
+
+string PivotTableSQLBuilder::SampleClause() const {
+	// System sampling keeps or skips whole vectors of rows, so the rows that are skipped are never filtered or
+	// aggregated. The sample is taken before the filters, so that the same fraction of every filter's rows is kept.
+	if (!args.Sampled()) {
+		return string();
+	}
+	// With a sample_seed, the same rows are sampled every time (as long as the tables do not change)
+	auto seed = args.sample_seed.IsValid() ? ", " + to_string(args.sample_seed.GetIndex()) : string();
+	return " TABLESAMPLE " + Value::DOUBLE(args.sample_fraction * 100).ToString() + " PERCENT (system" + seed + ")";
+}
+
+string PivotTableSQLBuilder::PivotTable() {
+	if (args.columns.empty()) {
+		AppendNoColumns();
+	} else if (args.ValuesOnRows()) {
+		AppendValuesAxisRows();
+	} else {
+		AppendValuesAxisColumns();
+	}
+	// With ORDER BY, a LIMIT only keeps the top rows instead of sorting all of them.
+	// Without it, the rows are streamed and the query stops as soon as there are enough of them.
+	if (args.max_rows.IsValid()) {
+		Append("\nLIMIT " + to_string(args.max_rows.GetIndex()));
+	}
+	return std::move(sql);
+}
+
+//===--------------------------------------------------------------------===//
+// Totals
+//===--------------------------------------------------------------------===//
+void PivotTableSQLBuilder::AppendGroupingSets(const string &extra_col) {
+	// A GROUPING SETS clause that aggregates the raw data at the detail level of granularity and at every subtotal
+	// and/or grand_total level in a single pass (instead of one copy of the raw data per level).
+	// Each subtotal level drops one more of the rows from the right, and the grand_total level drops all of them
+	// (there is no subtotal on the first row). The extra_col (the pivot key) is added to every grouping set.
+	// Ex: GROUPING SETS (("category", "subcat", key), ("category", key), (key))
+	auto row_count = args.rows.size();
+	// The number of rows kept at each level: the detail level, then the subtotal levels and the grand_total level
+	vector<idx_t> levels {row_count};
+	for (idx_t level = row_count; level > 0; level--) {
+		bool is_grand_total = level == 1;
+		if ((!is_grand_total && args.subtotals) || (is_grand_total && args.grand_totals)) {
+			levels.push_back(level - 1);
+		}
+	}
+	Append("GROUPING SETS (");
+	for (idx_t i = 0; i < levels.size(); i++) {
+		Append(i == 0 ? "(" : ", (");
+		for (idx_t r = 0; r < levels[i]; r++) {
+			Append(DQ(args.rows[r]));
+			Append(", ");
+		}
+		Append(extra_col);
+		Append(")");
+	}
+	Append(")");
+}
+
+void PivotTableSQLBuilder::AppendGroupingId() {
+	// A bitmask with one bit per row, set if that row was rolled up into a subtotal or grand_total
+	// (the first row is the most significant bit). Ex: GROUPING("category", "subcat")
+	if (args.rows.empty()) {
+		Append("0");
+		return;
+	}
+	Append("GROUPING(");
+	AppendQuoted(args.rows, ", ", DQ);
+	Append(")");
+}
+
+void PivotTableSQLBuilder::AppendRolledUp(const string &row) {
+	// 1 if the row was rolled up, using the pivot_grouping_id column. Ex: (pivot_grouping_id >> 1) & 1
+	idx_t position = 0;
+	while (position + 1 < args.rows.size() && args.rows[position] != row) {
+		position++;
+	}
+	Append("(pivot_grouping_id >> " + to_string(args.rows.size() - 1 - position) + ") & 1");
+}
+
+void PivotTableSQLBuilder::AppendRowLabels() {
+	// Rows that were rolled up into a subtotal or grand_total are replaced with a static string.
+	// This is only done for the final output (after sorting), since it casts the row columns to varchar.
+	if (!HasTotals()) {
+		AppendQuoted(args.rows, ", ", DQ);
+		return;
+	}
+	for (idx_t i = 0; i < args.rows.size(); i++) {
+		if (i > 0) {
+			Append(", ");
+		}
+		// Only the grand_total level rolls up the first row
+		Append("CASE WHEN ");
+		AppendRolledUp(args.rows[0]);
+		Append(" = 1 THEN 'Grand Total' WHEN ");
+		AppendRolledUp(args.rows[i]);
+		Append(" = 1 THEN 'Subtotal' ELSE " + DQ(args.rows[i]) + "::varchar END AS " + DQ(args.rows[i]));
+	}
+}
+
+void PivotTableSQLBuilder::AppendTotalsOutput(const string &relation, const vector<string> &extra_cols,
+                                              const string &empty_col, bool sample_rows_last) {
+	// The final query over a relation that has the columns: dummy_column, pivot_grouping_id, rows,
+	// any other extra_cols (Ex: value_names), then the values. If there is an empty_col, it holds the result of the
+	// value over zero rows, which replaces the NULL values (the pivoted cells without data), and is not returned.
+	// The rows are sorted using their own types (Ex: 2 before 10), and each subtotal and grand_total is sorted
+	// below the rows it totals using the bits of pivot_grouping_id. They are labelled only after that.
+	// The row columns are qualified in the ORDER BY, so they refer to the typed columns and not the labels.
+	// The sort is on the (much smaller) aggregated rows only, and is left out entirely if the output is not ordered.
+	Append("FROM " + relation + "\nSELECT dummy_column, ");
+	if (!args.rows.empty()) {
+		AppendRowLabels();
+		Append(", ");
+	}
+	for (auto &col : extra_cols) {
+		Append(col + ", ");
+	}
+	// With sample_rows_last, the columns of the sample_rows value (named <key>_sample_rows by the PIVOT) are selected
+	// after every other value, so that the exact layout comes first
+	vector<string> suffix_conditions {string()};
+	if (sample_rows_last && args.Sampled()) {
+		suffix_conditions = {" AND NOT suffix(c, '_sample_rows')", " AND suffix(c, '_sample_rows')"};
+	}
+	for (idx_t i = 0; i < suffix_conditions.size(); i++) {
+		Append(i == 0 ? "" : ", ");
+		Append(empty_col.empty() ? "COLUMNS(c -> NOT list_contains([" : "coalesce(COLUMNS(c -> NOT list_contains([");
+		AppendQuoted(args.rows, ", ", SQ);
+		if (!args.rows.empty() && !extra_cols.empty()) {
+			Append(", ");
+		}
+		AppendQuoted(extra_cols, ", ", SQ);
+		Append("], c) AND c NOT IN ('dummy_column', 'pivot_grouping_id'");
+		if (empty_col.empty()) {
+			Append(")" + suffix_conditions[i] + ")");
+		} else {
+			Append(", " + SQ(empty_col) + ")" + suffix_conditions[i] + "), " + empty_col + ")");
+		}
+	}
+	if (!args.ordered) {
+		return;
+	}
+	Append("\nORDER BY dummy_column");
+	for (auto &row : args.rows) {
+		Append(", ");
+		AppendRolledUp(row);
+		Append(", " + relation + "." + DQ(row) + " NULLS FIRST");
+	}
+	for (auto &col : extra_cols) {
+		// The sample_rows row of each output row comes after the rows of the values that it counts the sample of
+		if (col == "value_names" && args.Sampled()) {
+			Append(", value_names = 'sample_rows'");
+		}
+		Append(", " + col + " NULLS FIRST");
+	}
+}
+
+//===--------------------------------------------------------------------===//
+// No columns
+//===--------------------------------------------------------------------===//
+void PivotTableSQLBuilder::AppendNoColumns() {
+	// If no columns are being pivoted horizontally, use a group by operation to create the output table
+	auto row_count = args.rows.size();
+	auto all_rolled_up = to_string((idx_t(1) << row_count) - 1);
+	Append("WITH ");
+	AppendFiltered();
+	Append("\nFROM filtered\nSELECT 1 AS dummy_column");
+
+	// ROWS
+	// If using subtotals or grand_totals, detect which rows are subtotals and/or grand_totals using the GROUPING
+	// function, since in these cases GROUPING SETS are in use. The GROUPING id has one bit per row, so all bits
+	// are set for the grand_total. Then replace what would have been a NULL with the text Grand Total or Subtotal.
+	for (auto &row : args.rows) {
+		Append(", ");
+		if (!HasTotals()) {
+			Append(DQ(row));
+			continue;
+		}
+		Append("CASE WHEN ");
+		AppendGroupingId();
+		Append(" = " + all_rolled_up + " THEN 'Grand Total' WHEN GROUPING(" + DQ(row) +
+		       ") = 1 THEN 'Subtotal' ELSE " + DQ(row) + "::varchar END AS " + DQ(row));
+	}
+
+	// VALUES
+	// If values_axis is columns, then just have a separate column for each value.
+	// If values_axis is rows, unnest so that there is a separate row for each value.
+	if (args.ValuesOnRows()) {
+		Append(", UNNEST([");
+		AppendQuoted(args.values, ", ", SQ);
+		Append("]) AS value_names, UNNEST([");
+		for (idx_t i = 0; i < args.values.size(); i++) {
+			Append((i == 0 ? "" : ", ") + EstimateExpression(args.values[i]));
+		}
+		Append("]) AS values");
+	} else {
+		// A rewritten value keeps the name of the value that was passed in
+		for (auto &value : args.values) {
+			auto expression = EstimateExpression(value);
+			Append(", " + expression + (expression == NQ(value) ? "" : " AS " + DQ(value)));
+		}
+	}
+	Append("\n");
+
+	// If using subtotals, use a ROLLUP (note this will include a grand_total, which is filtered out with a HAVING
+	// clause if grand_totals is off). If using grand totals and not subtotals, use GROUPING SETS to add just a total.
+	// If no subtotals or grand totals, just GROUP BY ALL.
+	Append("GROUP BY ");
+	if (args.subtotals && row_count > 0) {
+		Append("ROLLUP (");
+		AppendQuoted(args.rows, ", ", DQ);
+		Append(")");
+	} else if (args.grand_totals && row_count > 0) {
+		Append("GROUPING SETS ((), (");
+		AppendQuoted(args.rows, ", ", DQ);
+		Append("))");
+	} else {
+		Append("ALL");
+	}
+	Append("\n");
+	if (args.subtotals && !args.grand_totals && row_count > 0) {
+		Append("HAVING ");
+		AppendGroupingId();
+		Append(" != " + all_rolled_up + "\n");
+	}
+
+	// If using subtotals or grand_totals, ensure the subtotal/grand_total rows are sorted below non-total values.
+	// The value_names column keeps the ordering deterministic when values_axis is rows.
+	if (!args.ordered) {
+		return;
+	}
+	Append("ORDER BY ");
+	if (!HasTotals()) {
+		Append("ALL NULLS FIRST");
+		return;
+	}
+	// The rows are qualified so that they sort by their own types, not as the VARCHAR labels with the same names
+	for (idx_t i = 0; i < row_count; i++) {
+		Append((i == 0 ? "GROUPING(" : ", GROUPING(") + DQ(args.rows[i]) + "), filtered." + DQ(args.rows[i]));
+	}
+	if (args.ValuesOnRows()) {
+		Append(args.Sampled() ? ", value_names = 'sample_rows', value_names" : ", value_names");
+	}
+}
+
+//===--------------------------------------------------------------------===//
+// Pivot keys
+//===--------------------------------------------------------------------===//
+string PivotTableSQLBuilder::KeyStruct() const {
+	// The typed pivot key: a STRUCT with one field per column. Grouping on the typed values avoids casting and
+	// concatenating them into a string for every raw row, and distinct combinations of values can never collide.
+	// Ex: struct_pack(k1 := "year", k2 := "quarter")
+	string result = "struct_pack(";
+	for (idx_t i = 0; i < args.columns.size(); i++) {
+		result += (i == 0 ? "k" : ", k") + to_string(i + 1) + " := " + DQ(args.columns[i]);
+	}
+	return result + ")";
+}
+
+string PivotTableSQLBuilder::CollapsedKeyStruct() const {
+	// The pivot key when the keys past the top ones are collapsed (see AppendRankedKeys): every collapsed key is the
+	// same Other key. The pivot_other field comes first, so that the Other key sorts after every other key.
+	// Ex: struct_pack(pivot_other := NOT pivot_key_kept, k1 := CASE WHEN pivot_key_kept THEN "year" END)
+	string result = "struct_pack(pivot_other := NOT pivot_key_kept";
+	for (idx_t i = 0; i < args.columns.size(); i++) {
+		result += ", k" + to_string(i + 1) + " := CASE WHEN pivot_key_kept THEN " + DQ(args.columns[i]) + " END";
+	}
+	return result + ")";
+}
+
+void PivotTableSQLBuilder::AppendRankedKeys() {
+	// Every pivot key, and whether it is kept: all of them if there are at most max_pivot_keys, otherwise the top
+	// max_pivot_keys - 1 by rank_by (the rest are collapsed into the Other key). This is an extra aggregation of the
+	// filtered data by the pivot key only, which is joined back to the filtered rows before they are aggregated,
+	// so that every value (not only the ones that can be merged) is computed over the rows of the Other key.
+	auto max_pivot_keys = to_string(args.max_pivot_keys.GetIndex());
+	auto rank_by = !args.rank_by.empty()  ? NQ(args.rank_by)
+	               : args.values.empty() ? "count(*)"
+	                                     : EstimateExpression(args.values[0]);
+	Append(", ranked_keys AS (\nFROM filtered\nSELECT " + KeyStruct() + " AS pivot_ranked_key, ");
+	Append("row_number() OVER (ORDER BY " + rank_by + " DESC NULLS LAST, " + KeyStruct() + ") < " +
+	       max_pivot_keys + " OR count(*) OVER () <= " + max_pivot_keys + " AS pivot_key_kept\nGROUP BY 1\n)");
+}
+
+void PivotTableSQLBuilder::AppendKeyName(const string &key) {
+	// Concatenate every field of the key together with an _ separator (Ex: 2022_Q1). NULL fields are shown as NULL.
+	if (args.CollapseKeys()) {
+		Append("CASE WHEN " + key + ".pivot_other THEN 'Other' ELSE ");
+	}
+	for (idx_t i = 0; i < args.columns.size(); i++) {
+		Append((i == 0 ? "coalesce(" : " || '_' || coalesce(") + key + ".k" + to_string(i + 1) +
+		       "::varchar, 'NULL')");
+	}
+	if (args.CollapseKeys()) {
+		Append(" END");
+	}
+}
+
+void PivotTableSQLBuilder::AppendKeyLabel(const string &key) {
+	// Convert the key into its output column name. Distinct keys can have the same name
+	// (Ex: ('a_b', 'c') and ('a', 'b_c') are both a_b_c), so every key after the first (in key order) with a repeated
+	// name gets a suffix (Ex: a_b_c (2)). This is a window over all keys, so the enum and the pivot must both
+	// evaluate it after the same filters.
+	Append("CASE WHEN " + key + " IS NULL THEN NULL ELSE ");
+	AppendKeyName(key);
+	Append(" || CASE WHEN dense_rank() OVER (PARTITION BY ");
+	AppendKeyName(key);
+	Append(" ORDER BY " + key + ") = 1 THEN '' ELSE ' (' || dense_rank() OVER (PARTITION BY ");
+	AppendKeyName(key);
+	Append(" ORDER BY " + key + ") || ')' END END");
+}
+
+void PivotTableSQLBuilder::AppendPivotKey(const string &key) {
+	// The key is a different grouping expression than a column that is in both the rows and the columns
+	// (otherwise that column could never be rolled up). Such a column is replaced with a static string at the
+	// subtotal and grand_total levels, so no pivot key matches there: the key is NULL so the cells are empty.
+	vector<string> overlap;
+	if (HasTotals()) {
+		for (auto &column : args.columns) {
+			if (std::find(args.rows.begin(), args.rows.end(), column) != args.rows.end() &&
+			    std::find(overlap.begin(), overlap.end(), column) == overlap.end()) {
+				overlap.push_back(column);
+			}
+		}
+	}
+	if (overlap.empty()) {
+		Append(key);
+		return;
+	}
+	Append("CASE WHEN ");
+	for (idx_t i = 0; i < overlap.size(); i++) {
+		Append((i == 0 ? "GROUPING(" : " OR GROUPING(") + DQ(overlap[i]) + ") = 1");
+	}
+	Append(" THEN NULL ELSE " + key + " END");
+}
+
+void PivotTableSQLBuilder::AppendValueList(const string &prefix) {
+	// Each value expression is aliased by its position, so that the aggregated values can be referenced no matter
+	// what text the value expression contains. If no values are passed in, count the rows (the PIVOT default).
+	if (args.values.empty()) {
+		Append("count(*) AS " + prefix + "1");
+		return;
+	}
+	for (idx_t i = 0; i < args.values.size(); i++) {
+		Append((i == 0 ? "" : ", ") + EstimateExpression(args.values[i]) + " AS " + prefix + to_string(i + 1));
+	}
+}
+
+//===--------------------------------------------------------------------===//
+// Per table partial aggregation
+//===--------------------------------------------------------------------===//
+static string PartialAggregateName(const string &value) {
+	// Only a single call to sum, count, min, max or avg with one plain argument (Ex: sum(x * 2) or count(*)) can be
+	// aggregated per table and then merged. Anything else (DISTINCT, FILTER, ORDER BY, several arguments, nested
+	// calls, arithmetic on the result, ...) is aggregated over all of the tables at once.
+	auto open = value.find('(');
+	if (open == string::npos || value.back() != ')' || value.find_first_of("'\"(,", open + 1) != string::npos ||
+	    value.find(')') != value.size() - 1) {
+		return string();
+	}
+	auto name = StringUtil::Lower(value.substr(0, open));
+	StringUtil::Trim(name);
+	auto argument = StringUtil::Lower(value.substr(open + 1, value.size() - open - 2));
+	StringUtil::Trim(argument);
+	if (argument.empty() || StringUtil::StartsWith(argument, "distinct ") || StringUtil::StartsWith(argument, "all ") ||
+	    StringUtil::Contains(argument, " order ")) {
+		return string();
+	}
+	if (name == "sum" || name == "count" || name == "min" || name == "max") {
+		return name;
+	}
+	if (name == "avg" || name == "mean") {
+		return "avg";
+	}
+	return string();
+}
+
+//! The approximate aggregate that replaces a single call to an exact one, if there is one
+static string ApproximateAggregate(const string &value) {
+	auto open = value.find('(');
+	if (open == string::npos || value.back() != ')' || value.find('(', open + 1) != string::npos ||
+	    value.find(')') != value.size() - 1) {
+		return value;
+	}
+	auto name = StringUtil::Lower(value.substr(0, open));
+	StringUtil::Trim(name);
+	auto arguments = value.substr(open + 1, value.size() - open - 2);
+	StringUtil::Trim(arguments);
+	if (name == "count" && StringUtil::StartsWith(StringUtil::Lower(arguments), "distinct ")) {
+		auto argument = arguments.substr(9);
+		StringUtil::Trim(argument);
+		return "approx_count_distinct(" + argument + ")";
+	}
+	if (name == "median") {
+		return "reservoir_quantile(" + arguments + ", 0.5)";
+	}
+	if (name == "quantile" || name == "quantile_cont" || name == "quantile_disc") {
+		return "reservoir_quantile(" + arguments + ")";
+	}
+	return value;
+}
+
+string PivotTableSQLBuilder::AggregateExpression(const string &value) const {
+	// The aggregate of a value over the rows that are read: with a sample, sample_rows counts the rows of the sample.
+	// With approx, an exact aggregate is replaced by its approximate counterpart.
+	if (args.Sampled() && value == "sample_rows") {
+		return "count(*)";
+	}
+	return args.approx ? ApproximateAggregate(NQ(value)) : NQ(value);
+}
+
+string PivotTableSQLBuilder::EstimateExpression(const string &value) const {
+	// With a sample, a sum or a count over the sample is scaled up to estimate it over every row. A sum is multiplied
+	// by the integer ratio that approximates 1 / sample_fraction (to 9 decimals), so that a sum of integers stays a
+	// HUGEINT (truncated toward zero), and a count stays a BIGINT. Any other aggregate (Ex: an avg, a min or an
+	// approx_count_distinct) is the one over the sample.
+	auto expression = AggregateExpression(value);
+	if (!args.Sampled() || value == "sample_rows") {
+		return expression;
+	}
+	auto name = PartialAggregateName(expression);
+	if (name == "sum") {
+		int64_t denominator = 1000000000;
+		auto numerator = MaxValue<int64_t>(int64_t(std::llround(args.sample_fraction * double(denominator))), 1);
+		auto a = numerator;
+		auto b = denominator;
+		while (b != 0) {
+			auto r = a % b;
+			a = b;
+			b = r;
+		}
+		return "(" + expression + " * " + to_string(denominator / a) + " // " + to_string(numerator / a) + ")";
+	}
+	if (name == "count") {
+		auto fraction = Value::DOUBLE(args.sample_fraction).ToString() + "::DOUBLE";
+		return "round(" + expression + " / " + fraction + ")::BIGINT";
+	}
+	return expression;
+}
+
+bool PivotTableSQLBuilder::MergeableValues() const {
+	for (auto &value : args.values) {
+		// An avg is aggregated in two parts (its sum and its count), so it can not be stored as a single partial
+		auto name = PartialAggregateName(AggregateExpression(value));
+		if (name.empty() || name == "avg") {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool PivotTableSQLBuilder::SimpleValues() const {
+	for (auto &value : args.values) {
+		if (PartialAggregateName(AggregateExpression(value)).empty()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool PivotTableSQLBuilder::AggregatePerTable() const {
+	// With a single table, aggregating in parts only pays off when there are totals: the raw rows are then
+	// aggregated once, by rows and pivot key, and every level of totals is computed from that (much smaller) result.
+	// The Other key can only be known once every table has been aggregated by pivot key.
+	return by_name && args.aggregate_in_parts && (args.table_names.size() > 1 || HasTotals()) && SimpleValues() &&
+	       !args.CollapseKeys();
+}
+
+void PivotTableSQLBuilder::AppendPartials(const vector<string> &table_filters, bool aggregate_tables) {
+	// Aggregate each table on its own, at the most detailed level (the rows and the pivot key) only.
+	// Each branch is a separate pipeline, so the tables are scanned and aggregated in parallel, and their filters
+	// are pushed into their own scans. The partial results are combined by name, so the tables do not need to
+	// have their columns in the same order. The stored partials (if any) are combined the same way.
+	// The tables are read directly when there is a filter per table, so that it can refer to the rowid.
+	// The rows that PartitionScan copied are read instead of the tables, and they are already sampled and filtered.
+	auto scanned = !partition_scan_table.empty();
+	auto table_names = scanned ? vector<string> {partition_scan_table} : args.table_names;
+	auto sample = scanned ? string() : SampleClause();
+	auto has_filters = !scanned && !args.filters.empty();
+	Append("partials AS (\n");
+	for (idx_t t = 0; aggregate_tables && t < table_names.size(); t++) {
+		if (t > 0) {
+			Append("\nUNION ALL BY NAME\n");
+		}
+		if (table_filters.empty()) {
+			Append("FROM query_table([" + DQ(table_names[t]) + "])" + sample + "\nSELECT ");
+		} else {
+			Append("FROM " + TableReference(table_names[t]) + sample + "\nSELECT ");
+		}
+		for (auto &row : args.rows) {
+			Append(DQ(row) + ", ");
+		}
+		Append(KeyStruct());
+		Append(" AS pivot_partial_key, ");
+		AppendPartialValueList();
+		if (!table_filters.empty() || has_filters) {
+			Append("\nWHERE 1=1");
+		}
+		if (!table_filters.empty()) {
+			Append(" AND " + table_filters[t]);
+		}
+		if (has_filters) {
+			Append(" AND ");
+			AppendQuoted(args.filters, " AND ", NQ);
+		}
+		Append("\nGROUP BY ALL");
+	}
+	if (!partials_table.empty()) {
+		Append(aggregate_tables ? "\nUNION ALL BY NAME\n" : "");
+		Append("FROM " + TableReference(partials_table));
+	}
+	Append("\n)");
+}
+
+void PivotTableSQLBuilder::AppendPartialValueList() {
+	// Each value is aggregated into a single partial, except for an avg, which is aggregated into its sum and its count
+	// (Ex: avg(x) becomes sum(x) AS pivot_partial_1, count(x) AS pivot_partial_1_count)
+	if (args.values.empty()) {
+		AppendValueList("pivot_partial_");
+		return;
+	}
+	for (idx_t i = 0; i < args.values.size(); i++) {
+		auto expression = AggregateExpression(args.values[i]);
+		auto index = to_string(i + 1);
+		if (i > 0) {
+			Append(", ");
+		}
+		if (PartialAggregateName(expression) == "avg") {
+			auto argument = expression.substr(expression.find('('));
+			Append("sum" + argument + " AS pivot_partial_" + index + ", count" + argument + " AS pivot_partial_" +
+			       index + "_count");
+		} else {
+			Append(EstimateExpression(args.values[i]) + " AS pivot_partial_" + index);
+		}
+	}
+}
+
+void PivotTableSQLBuilder::AppendMergedValueList(const string &prefix) {
+	// Merge the partial aggregates of every table: the sum of the sums and counts, the min of the mins and so on.
+	// A count is never NULL, even without any rows. An avg is the sum of its sums over the sum of its counts, which
+	// is NULL without any rows (like the avg itself).
+	auto value_count = MaxValue<idx_t>(args.values.size(), 1);
+	for (idx_t i = 0; i < value_count; i++) {
+		auto index = to_string(i + 1);
+		auto name = args.values.empty() ? "count" : PartialAggregateName(AggregateExpression(args.values[i]));
+		if (i > 0) {
+			Append(", ");
+		}
+		if (name == "count") {
+			Append("coalesce(sum(pivot_partial_" + index + "), 0)::BIGINT");
+		} else if (name == "avg") {
+			Append("sum(pivot_partial_" + index + ")::DOUBLE / sum(pivot_partial_" + index + "_count)");
+		} else {
+			Append(name + "(pivot_partial_" + index + ")");
+		}
+		Append(" AS " + prefix + index);
+	}
+}
+
+void PivotTableSQLBuilder::AppendMergedPartialList() {
+	// Merge the partial aggregates into partial aggregates again, so that they can be merged once more later: an avg
+	// stays its sum and its count, and a count stays NULL without any rows
+	auto value_count = MaxValue<idx_t>(args.values.size(), 1);
+	for (idx_t i = 0; i < value_count; i++) {
+		auto index = to_string(i + 1);
+		auto name = args.values.empty() ? "count" : PartialAggregateName(AggregateExpression(args.values[i]));
+		auto merge = name == "min" || name == "max" ? name : "sum";
+		Append((i == 0 ? "" : ", ") + merge + "(pivot_partial_" + index + ") AS pivot_partial_" + index);
+		if (name == "avg") {
+			Append(", sum(pivot_partial_" + index + "_count) AS pivot_partial_" + index + "_count");
+		}
+	}
+}
+
+void PivotTableSQLBuilder::AppendFinalizedValueList(const string &prefix) {
+	// The values of partial aggregates that are already merged, without aggregating them again: the same results as
+	// AppendMergedValueList over a single partial
+	auto value_count = MaxValue<idx_t>(args.values.size(), 1);
+	for (idx_t i = 0; i < value_count; i++) {
+		auto index = to_string(i + 1);
+		auto name = args.values.empty() ? "count" : PartialAggregateName(AggregateExpression(args.values[i]));
+		if (i > 0) {
+			Append(", ");
+		}
+		if (name == "count") {
+			Append("coalesce(pivot_partial_" + index + ", 0)::BIGINT");
+		} else if (name == "avg") {
+			Append("pivot_partial_" + index + "::DOUBLE / pivot_partial_" + index + "_count");
+		} else {
+			Append("pivot_partial_" + index);
+		}
+		Append(" AS " + prefix + index);
+	}
+}
+
+string PivotTableSQLBuilder::Partials(const vector<string> &table_filters) {
+	// The new partials are merged with the stored ones, so the result has a single row per rows and pivot key
+	D_ASSERT(table_filters.size() == args.table_names.size());
+	D_ASSERT(MergeableValues());
+	Append("WITH ");
+	AppendPartials(table_filters, true);
+	Append("\nFROM partials\nSELECT ");
+	for (auto &row : args.rows) {
+		Append(DQ(row) + ", ");
+	}
+	Append("pivot_partial_key, ");
+	AppendMergedValueList("pivot_partial_");
+	Append("\nGROUP BY ALL");
+	return std::move(sql);
+}
+
+string PivotTableSQLBuilder::PartitionScan(const vector<string> &columns) {
+	// The tables are read once, for all of the partitions. The partition is computed once per row, on the typed values of
+	// the rows and columns once the tables are combined (like the grouping is), so a detail group is in a single
+	// partition. The rows are sorted by partition, so each partition is in its own row groups of the copy, which the
+	// statistics of pivot_partition let the other partitions skip.
+	D_ASSERT(!args.columns.empty());
+	vector<string> group_columns = args.rows;
+	group_columns.insert(group_columns.end(), args.columns.begin(), args.columns.end());
+	Append("WITH ");
+	AppendFiltered();
+	Append("\nFROM filtered\nSELECT ");
+	if (columns.empty()) {
+		Append("*");
+	} else {
+		AppendQuoted(columns, ", ", DQ);
+	}
+	Append(", hash(");
+	AppendQuoted(group_columns, ", ", DQ);
+	Append(") % " + to_string(args.partitions) + " AS pivot_partition\nORDER BY pivot_partition");
+	return std::move(sql);
+}
+
+string PivotTableSQLBuilder::PartitionPartials(idx_t partition) {
+	// A detail group is in a single partition, so once the partials of the tables are merged here, the detail groups
+	// of different partitions never have to be merged together. The subtotal and grand_total levels of the partition
+	// are merged from its detail groups in the same pass, so only these (much smaller) totals of the partitions are
+	// merged once every partition is read back.
+	D_ASSERT(SimpleValues() && !args.columns.empty() && !partition_scan_table.empty());
+	vector<string> table_filters {"pivot_partition = " + to_string(partition)};
+	Append("WITH ");
+	AppendPartials(table_filters, true);
+	Append("\nFROM partials\nSELECT ");
+	for (auto &row : args.rows) {
+		Append(DQ(row) + ", ");
+	}
+	AppendGroupingId();
+	Append(" AS pivot_grouping_id, " + to_string(partition) + " AS pivot_partition, ");
+	AppendPivotKey("pivot_partial_key");
+	Append(" AS pivot_partial_key, ");
+	AppendMergedPartialList();
+	Append("\nGROUP BY ");
+	AppendGroupingSets("pivot_partial_key");
+	return std::move(sql);
+}
+
+//===--------------------------------------------------------------------===//
+// Columns
+//===--------------------------------------------------------------------===//
+void PivotTableSQLBuilder::AppendGroupedCTEs(bool per_table) {
+	// The filtered data is scanned only once: a single GROUPING SETS aggregation computes every value
+	// at every requested level of granularity (detail rows, each subtotal level, and the grand total) for each
+	// pivot key. The rows keep their own types, and are only labelled after sorting (see AppendTotalsOutput).
+	// Only the combinations of columns that actually exist in the data are pivoted, since the PIVOT is only ON
+	// one expression (a STRUCT of all of the columns, named after aggregation).
+	// When aggregating per table (or reading stored partials), the levels are computed from the (much smaller)
+	// merged partials instead. The partials of partitions already hold every level (see AppendPartitionsGroupedByKey).
+	string key = per_table ? "pivot_partial_key" : args.CollapseKeys() ? CollapsedKeyStruct() : KeyStruct();
+	if (partitioned) {
+		AppendPartials({}, false);
+		AppendPartitionsGroupedByKey();
+	} else {
+		if (per_table) {
+			AppendPartials(per_table_filters, partials_table.empty() || !per_table_filters.empty());
+			Append(", grouped_by_key AS (\nFROM partials\nSELECT 1 AS dummy_column, ");
+		} else if (args.CollapseKeys()) {
+			AppendFiltered();
+			AppendRankedKeys();
+			Append(", grouped_by_key AS (\nFROM filtered\nJOIN ranked_keys ON " + KeyStruct() +
+			       " IS NOT DISTINCT FROM pivot_ranked_key\nSELECT 1 AS dummy_column, ");
+		} else {
+			AppendFiltered();
+			Append(", grouped_by_key AS (\nFROM filtered\nSELECT 1 AS dummy_column, ");
+		}
+		for (auto &row : args.rows) {
+			Append(DQ(row) + ", ");
+		}
+		AppendGroupingId();
+		Append(" AS pivot_grouping_id, ");
+		AppendPivotKey(key);
+		Append(" AS pivot_columns_key, ");
+		if (per_table) {
+			AppendMergedValueList("pivot_value_");
+		} else {
+			AppendValueList("pivot_value_");
+		}
+		Append("\nGROUP BY ");
+		AppendGroupingSets(key);
+	}
+
+	// Name each pivot key only now that the (much smaller) aggregated result is available
+	// With several values on rows, grouped is read once per value (see AppendTransposedValues), so it is materialized
+	Append(args.ValuesOnRows() && args.values.size() > 1 ? "\n), grouped AS MATERIALIZED (" : "\n), grouped AS (");
+	Append("\nFROM grouped_by_key\nSELECT * REPLACE (");
+	AppendKeyLabel("pivot_columns_key");
+
+	// The result of each value when aggregating zero rows (Ex: 0 for count(*), NULL for sum(...)).
+	// This is used for the pivoted cells that have no data, matching what a PIVOT directly on the raw data produces.
+	Append(" AS pivot_columns_key)\n), empty_values AS (\n");
+	if (per_table) {
+		Append("FROM partials\nSELECT ");
+		AppendMergedValueList("pivot_value_");
+	} else {
+		Append("FROM filtered\nSELECT ");
+		AppendValueList("pivot_value_");
+	}
+	Append("\nWHERE false\n)");
+}
+
+void PivotTableSQLBuilder::AppendPartitionsGroupedByKey() {
+	// A detail group is complete in its partition (see PartitionPartials), so the detail groups are only finalized,
+	// without aggregating them again. Only the subtotals and grand_totals of every partition are merged.
+	Append(", grouped_by_key AS (\nFROM partials\nSELECT 1 AS dummy_column, ");
+	for (auto &row : args.rows) {
+		Append(DQ(row) + ", ");
+	}
+	Append("pivot_grouping_id, pivot_partial_key AS pivot_columns_key, ");
+	AppendFinalizedValueList("pivot_value_");
+	Append("\nWHERE pivot_grouping_id = 0");
+	if (!HasTotals()) {
+		return;
+	}
+	Append("\nUNION ALL BY NAME\nFROM partials\nSELECT 1 AS dummy_column, ");
+	for (auto &row : args.rows) {
+		Append(DQ(row) + ", ");
+	}
+	Append("pivot_grouping_id, pivot_partial_key AS pivot_columns_key, ");
+	AppendMergedValueList("pivot_value_");
+	Append("\nWHERE pivot_grouping_id != 0\nGROUP BY ALL");
+}
+
+void PivotTableSQLBuilder::AppendEmptyValues() {
+	// The result of each value over zero rows, renamed so that it can be read next to the aggregated values
+	// (Ex: CROSS JOIN (FROM empty_values SELECT pivot_value_1 AS empty_value_1))
+	Append("CROSS JOIN (FROM empty_values SELECT ");
+	auto value_count = MaxValue<idx_t>(args.values.size(), 1);
+	for (idx_t i = 0; i < value_count; i++) {
+		auto index = to_string(i + 1);
+		Append((i == 0 ? "pivot_value_" : ", pivot_value_") + index + " AS empty_value_" + index);
+	}
+	Append(")");
+}
+
+bool PivotTableSQLBuilder::CountValue(idx_t index) const {
+	// A single call to count (Ex: count(*), count(DISTINCT x) or its approximation), which is 0 over zero rows.
+	// Without values, the rows are counted.
+	if (args.values.empty()) {
+		return true;
+	}
+	auto expression = AggregateExpression(args.values[index]);
+	auto open = expression.find('(');
+	if (open == string::npos || expression.back() != ')' || expression.find('(', open + 1) != string::npos) {
+		return false;
+	}
+	auto name = StringUtil::Lower(expression.substr(0, open));
+	StringUtil::Trim(name);
+	return name == "count" || name == "count_star" || name == "approx_count_distinct";
+}
+
+string PivotTableSQLBuilder::PivotCell(idx_t index) const {
+	// A count is 0 in the cells without aggregated data (the only constant that a PIVOT expression can add)
+	auto cell = "first(pivot_value_" + to_string(index + 1) + " ORDER BY pivot_is_empty)";
+	return CountValue(index) ? "coalesce(" + cell + ", 0)" : cell;
+}
+
+void PivotTableSQLBuilder::AppendPivotInputCTEs() {
+	// The (much smaller) aggregated result is PIVOTed using first(pivot_value_N ORDER BY pivot_is_empty).
+	// The pivoted cells that have no data get the result of their value over zero rows, matching what a PIVOT
+	// directly on the raw data produces: a count is 0 (see PivotCell), and most other values are NULL, which needs no
+	// filling. Only if another value is not NULL over zero rows (Ex: coalesce(sum(x), 0)), the empty values are added
+	// once for every combination of rows and pivot key. They are sorted after the aggregated data, so they are only
+	// used if there is no aggregated data.
+	AppendGroupedCTEs(false);
+	Append(", pivot_input AS (\nFROM grouped\nSELECT *, 0 AS pivot_is_empty");
+	string not_empty;
+	for (idx_t i = 0; i < args.values.size(); i++) {
+		if (!CountValue(i)) {
+			not_empty += (not_empty.empty() ? "" : " OR ") + string("pivot_value_") + to_string(i + 1) + " IS NOT NULL";
+		}
+	}
+	if (!not_empty.empty()) {
+		Append("\nUNION ALL BY NAME\nFROM (SELECT DISTINCT dummy_column, pivot_grouping_id");
+		for (auto &row : args.rows) {
+			Append(", " + DQ(row));
+		}
+		Append(" FROM grouped)\n"
+		       "CROSS JOIN (SELECT unnest(enum_range(NULL::columns_parameter_enum))::varchar AS pivot_columns_key)\n"
+		       "CROSS JOIN (FROM empty_values WHERE " +
+		       not_empty + ")\nSELECT *, 1 AS pivot_is_empty");
+	}
+	Append("\n)");
+}
+
+void PivotTableSQLBuilder::AppendValuesAxisColumns() {
+	// If columns are being pivoted outward and the values_axis is columns, use a PIVOT statement.
+	// The PIVOT is wrapped in a CTE so that it can be sorted and the subtotal/grand_total rows can be labelled.
+	Append("WITH ");
+	AppendPivotInputCTEs();
+	Append(", raw_pivot AS (\nPIVOT pivot_input\nON pivot_columns_key IN columns_parameter_enum\nUSING ");
+	// With a single value, PIVOT names the columns after the keys only, so no alias is needed
+	if (args.values.size() <= 1) {
+		Append(PivotCell(0));
+	} else {
+		for (idx_t i = 0; i < args.values.size(); i++) {
+			Append((i == 0 ? "" : ", ") + PivotCell(i) + " AS " + DQ(args.values[i]));
+		}
+	}
+	Append("\nGROUP BY dummy_column, pivot_grouping_id");
+	for (auto &row : args.rows) {
+		Append(", " + DQ(row));
+	}
+	Append("\n)\n");
+	AppendTotalsOutput("raw_pivot", {}, string(), true);
+}
+
+void PivotTableSQLBuilder::AppendTransposedValues() {
+	// Transpose the aggregated values so that there is a separate row for each value, next to its name and to its
+	// result over zero rows (empty_value). The values are stacked with UNION ALL BY NAME instead of unnesting a list
+	// of them, so that values of different types (Ex: sum(x) and max(some_varchar)) are combined into a common type
+	// (VARCHAR if there is none), like stacking one PIVOT per value did.
+	for (idx_t i = 0; i < args.values.size(); i++) {
+		auto index = to_string(i + 1);
+		Append(i == 0 ? "FROM grouped\n" : "\nUNION ALL BY NAME\nFROM grouped\n");
+		AppendEmptyValues();
+		Append("\nSELECT dummy_column, pivot_grouping_id");
+		for (auto &row : args.rows) {
+			Append(", " + DQ(row));
+		}
+		Append(", " + SQ(args.values[i]) + " AS value_names, pivot_columns_key, pivot_value_" + index +
+		       " AS pivot_value, empty_value_" + index + " AS empty_value");
+	}
+}
+
+void PivotTableSQLBuilder::AppendValuesAxisRows() {
+	// If columns are being pivoted outward and the values_axis is rows, transpose the aggregated values so that
+	// there is a separate row for each value and use a single PIVOT statement.
+	// The result of each value over zero rows (empty_value) is the same on every row of a value, so it is grouped on,
+	// and fills in the cells that have no data once they are pivoted.
+	Append("WITH ");
+	AppendGroupedCTEs(false);
+	Append(", raw_pivot AS (\nPIVOT (\n");
+	AppendTransposedValues();
+	Append("\n)\nON pivot_columns_key IN columns_parameter_enum\n"
+	       "USING first(pivot_value)\nGROUP BY dummy_column, pivot_grouping_id");
+	for (auto &row : args.rows) {
+		Append(", " + DQ(row));
+	}
+	Append(", value_names, empty_value\n)\n");
+	AppendTotalsOutput("raw_pivot", {"value_names"}, "empty_value");
+}
+
+string PivotTableSQLBuilder::NativeInput() {
+	// The pivot keys are discovered and laid out as columns by pivot_table_native after this single pass over the
+	// raw data, so no enum is needed. With several tables, each table is aggregated separately when possible.
+	// The result of each value over zero rows is included on every row, to fill in pivoted cells that have no data.
+	auto value_count = MaxValue<idx_t>(args.values.size(), 1);
+	Append("WITH ");
+	AppendGroupedCTEs(!partials_table.empty() || !per_table_filters.empty() || AggregatePerTable());
+	Append(", native_input AS (\n");
+	if (args.ValuesOnRows()) {
+		AppendTransposedValues();
+	} else {
+		Append("FROM grouped\n");
+		AppendEmptyValues();
+		Append("\nSELECT dummy_column, pivot_grouping_id");
+		for (auto &row : args.rows) {
+			Append(", " + DQ(row));
+		}
+		Append(", pivot_columns_key");
+		for (auto prefix : {"pivot_value", "empty_value"}) {
+			for (idx_t i = 0; i < value_count; i++) {
+				Append(", " + string(prefix) + "_" + to_string(i + 1));
+			}
+		}
+	}
+	Append("\n)\n");
+	if (args.ValuesOnRows()) {
+		AppendTotalsOutput("native_input", {"value_names"});
+	} else {
+		AppendTotalsOutput("native_input", {});
+	}
+	// The pivot keys of each output row are sorted too, for when they are returned as rows (see max_pivot_keys)
+	if (args.ordered) {
+		Append(", pivot_columns_key");
+	}
+	return std::move(sql);
+}
+
+string PivotTableSQLBuilder::EstimatePivotKeys() {
+	// The filters and the columns are pushed into the table scans, so only those columns are read
+	Append("WITH ");
+	AppendFiltered();
+	Append("\nFROM filtered\nSELECT approx_count_distinct(" + KeyStruct() + ")");
+	return std::move(sql);
+}
+
+string PivotTableSQLBuilder::Enum(const vector<string> &table_names, const vector<string> &columns,
+                                  const vector<string> &filters, optional_idx max_pivot_keys) {
+	// The distinct keys are named the same way as in the pivot (Ex: 2022_Q1).
+	// This is safe to call with an empty columns list, so calling code can always create the enum.
+	// With max_pivot_keys, it fails before creating an enum (and a pivot) that is too wide.
+	PivotTableArguments args;
+	args.table_names = table_names;
+	args.columns = columns;
+	args.filters = filters;
+	PivotTableSQLBuilder builder(args);
+	builder.Append("WITH ");
+	builder.AppendFiltered();
+	builder.Append("\nFROM (\nFROM filtered\nSELECT DISTINCT ");
+	if (columns.empty()) {
+		builder.Append("1");
+	} else {
+		builder.Append(builder.KeyStruct());
+	}
+	builder.Append(" AS pivot_columns_key\n)\nSELECT ");
+	if (max_pivot_keys.IsValid()) {
+		auto limit = to_string(max_pivot_keys.GetIndex());
+		builder.Append("CASE WHEN count(*) OVER () > " + limit +
+		               " THEN error('build_my_enum: the columns parameter has ' || count(*) OVER () || ' distinct "
+		               "values, more than max_pivot_keys (" +
+		               limit + ")') ELSE ");
+	}
+	if (columns.empty()) {
+		builder.Append("pivot_columns_key");
+	} else {
+		builder.AppendKeyLabel("pivot_columns_key");
+	}
+	if (max_pivot_keys.IsValid()) {
+		builder.Append(" END");
+	}
+	builder.Append("\nORDER BY ALL");
+	return std::move(builder.sql);
+}
+
+string PivotTableSQLBuilder::BatchScan(const vector<string> &table_names, const vector<string> &columns,
+                                       const vector<vector<string>> &filters) {
+	// Each pivot applies its own filters again to the rows that are read here, so the filters of every pivot are
+	// combined with OR (and there is no WHERE clause if any of the pivots reads every row)
+	PivotTableArguments args;
+	args.table_names = table_names;
+	PivotTableSQLBuilder builder(args);
+	builder.CombineByName();
+	builder.Append("WITH ");
+	builder.AppendFiltered();
+	builder.Append("\nFROM filtered\nSELECT ");
+	if (columns.empty()) {
+		builder.Append("*");
+	} else {
+		builder.AppendQuoted(columns, ", ", DQ);
+	}
+	bool every_row = false;
+	for (auto &pivot_filters : filters) {
+		every_row = every_row || pivot_filters.empty();
+	}
+	if (every_row || filters.empty()) {
+		return std::move(builder.sql);
+	}
+	builder.Append("\nWHERE ");
+	for (idx_t i = 0; i < filters.size(); i++) {
+		builder.Append(i == 0 ? "((" : " OR ((");
+		builder.AppendQuoted(filters[i], ") AND (", NQ);
+		builder.Append("))");
+	}
+	return std::move(builder.sql);
+}
+
+//===--------------------------------------------------------------------===//
+// pivot_table_sql and pivot_table_enum_sql
+//===--------------------------------------------------------------------===//
+static vector<Value> GetListArguments(DataChunk &args, idx_t row, const vector<idx_t> &indexes) {
+	vector<Value> result;
+	for (auto index : indexes) {
+		result.push_back(args.data[index].GetValue(row));
+	}
+	return result;
+}
+
+static const char *const OPTION_PARAMETERS[] = {"values_axis", "subtotals", "grand_totals",    "ordered",
+                                                 "max_rows",    "approx",    "sample_fraction", "sample_seed"};
+
+static void PivotTableSQLScalarFun(DataChunk &args, ExpressionState &state, Vector &result) {
+	// The arguments are almost always constant, so this usually builds a single statement
+	for (idx_t row = 0; row < args.size(); row++) {
+		// ordered, max_rows, approx, sample_fraction and sample_seed are optional, so that calls from before they
+		// existed keep working
+		named_parameter_map_t options;
+		for (idx_t i = 0; i + 5 < args.ColumnCount(); i++) {
+			options[OPTION_PARAMETERS[i]] = args.data[5 + i].GetValue(row);
+		}
+		auto arguments =
+		    PivotTableArguments::FromValues("pivot_table", GetListArguments(args, row, {0, 1, 2, 3, 4}), options);
+		result.SetValue(row, Value(PivotTableSQLBuilder(arguments).PivotTable()));
+	}
+	if (args.AllConstant()) {
+		result.SetVectorType(VectorType::CONSTANT_VECTOR);
+	}
+}
+
+static void PivotTableEnumSQLScalarFun(DataChunk &args, ExpressionState &state, Vector &result) {
+	for (idx_t row = 0; row < args.size(); row++) {
+		auto lists = GetListArguments(args, row, {0, 1, 2});
+		auto table_names = ParseStringList("build_my_enum", lists[0], "table_names");
+		auto columns = ParseStringList("build_my_enum", lists[1], "columns");
+		auto filters = ParseStringList("build_my_enum", lists[2], "filters");
+		// max_pivot_keys is optional, so that calls from before it existed keep working
+		optional_idx max_pivot_keys;
+		if (args.ColumnCount() > 3) {
+			auto value = args.data[3].GetValue(row);
+			if (!value.IsNull()) {
+				if (value.GetValue<int64_t>() < 1) {
+					throw InvalidInputException("build_my_enum: max_pivot_keys must be at least 1");
+				}
+				max_pivot_keys = optional_idx(NumericCast<idx_t>(value.GetValue<int64_t>()));
+			}
+		}
+		result.SetValue(row, Value(PivotTableSQLBuilder::Enum(table_names, columns, filters, max_pivot_keys)));
+	}
+	if (args.AllConstant()) {
+		result.SetVectorType(VectorType::CONSTANT_VECTOR);
+	}
+}
+
+ScalarFunctionSet PivotTableSQLFunction::GetFunction() {
+	auto string_list = LogicalType::LIST(LogicalType::VARCHAR);
+	vector<LogicalType> arguments {string_list,          string_list,          string_list,         string_list,
+	                               string_list,          LogicalType::VARCHAR, LogicalType::BOOLEAN, LogicalType::BOOLEAN};
+	ScalarFunctionSet set("pivot_table_sql");
+	ScalarFunction function(arguments, LogicalType::VARCHAR, PivotTableSQLScalarFun);
+	function.null_handling = FunctionNullHandling::SPECIAL_HANDLING;
+	set.AddFunction(function);
+	function.arguments.push_back(LogicalType::BOOLEAN);
+	function.arguments.push_back(LogicalType::BIGINT);
+	set.AddFunction(function);
+	function.arguments.push_back(LogicalType::BOOLEAN);
+	function.arguments.push_back(LogicalType::DOUBLE);
+	set.AddFunction(function);
+	function.arguments.push_back(LogicalType::BIGINT);
+	set.AddFunction(function);
+	return set;
+}
+
+ScalarFunctionSet PivotTableSQLFunction::GetEnumFunction() {
+	auto string_list = LogicalType::LIST(LogicalType::VARCHAR);
+	ScalarFunctionSet set("pivot_table_enum_sql");
+	ScalarFunction function({string_list, string_list, string_list}, LogicalType::VARCHAR, PivotTableEnumSQLScalarFun);
+	function.null_handling = FunctionNullHandling::SPECIAL_HANDLING;
+	set.AddFunction(function);
+	function.arguments.push_back(LogicalType::BIGINT);
+	set.AddFunction(function);
+	return set;
+}
+
+} // namespace duckdb